@@ -0,0 +1,643 @@
+// micro-benchmarks behind the numbers quoted in the commit log. built with
+// -DBENCH=ON, run as bench <name> from a directory the fonts resolve from.
+// each prints one line per case.
+
+#include "../tests/harness.h"
+
+#include <unistd.h>
+
+#include <vector>
+
+internal double
+seconds_since(u64 start)
+{
+	return (double)(sys_ticks() - start) / (double)sys_tick_frequency();
+}
+
+// xorshift, so runs are repeatable.
+internal u32
+next_random(u32& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+////////
+//
+// glyph_map: find_glyph against the linear scan of the glyph list it
+// replaced, for fonts holding ascii plus n glyphs above latin-1.
+
+internal struct glyph *
+scan_glyph(struct font *font, u32 codepoint)
+{
+	for (i32 i = 0; i < font->glyphs.count; ++i)
+		if (font->glyphs.data[i].codepoint == codepoint)
+			return font->glyphs.data + i;
+	return 0;
+}
+
+internal void
+bench_glyph_map(void)
+{
+	const i32 lookup_count = 1 << 20;
+	u32 *lookups = allocate<u32>(lookup_count);
+
+	i32 sizes[] = { 0, 64, 512, 4096 };
+	for (i32 n : sizes) {
+		struct font *font = allocate<struct font>(1);
+		*font = {};
+		for (u32 c = ' '; c <= '~'; ++c)
+			add_glyph(font, c);
+		for (i32 i = 0; i < n; ++i)
+			add_glyph(font, 0x4E00 + (u32)i);
+
+		// text that is mostly ascii with the occasional wide character.
+		u32 random = 1;
+		for (i32 i = 0; i < lookup_count; ++i) {
+			u32 r = next_random(random);
+			lookups[i] = n && r % 8 == 0 ? 0x4E00 + (r >> 8) % (u32)n : ' ' + (r >> 8) % 95;
+		}
+
+		uintptr_t sum = 0;
+		u64 start = sys_ticks();
+		for (i32 i = 0; i < lookup_count; ++i)
+			sum += (uintptr_t)find_glyph(font, lookups[i]);
+		double hashed = seconds_since(start);
+
+		start = sys_ticks();
+		for (i32 i = 0; i < lookup_count; ++i)
+			sum -= (uintptr_t)scan_glyph(font, lookups[i]);
+		double scanned = seconds_since(start);
+
+		printf("glyph_map %5d glyphs: find_glyph %6.2f ns, scan %8.2f ns%s\n",
+			font->glyphs.count,
+			hashed * 1e9 / lookup_count, scanned * 1e9 / lookup_count,
+			sum ? " (mismatch)" : "");
+	}
+}
+
+////////
+//
+// rasterize: glyphs/s of a cold warmup of a large codepoint range with the
+// platform renderer, with the ink scan and coverage extraction done by the
+// kernels against the per pixel loops they replaced.
+
+internal bool
+scalar_ink_bounds(const u32 *bits, i32 width, i32 height, rect2i *result)
+{
+	i32 xmin = width;
+	i32 ymin = height;
+	i32 xmax = 0;
+	i32 ymax = 0;
+
+	const u32 *p = bits;
+	for (i32 y = 0; y < height; ++y) {
+		for (i32 x = 0; x < width; ++x) {
+			if (*p) {
+				xmin = min(xmin, x);
+				xmax = max(x, xmax);
+				ymin = min(ymin, y);
+				ymax = max(y, ymax);
+			}
+			++p;
+		}
+	}
+
+	*result = { xmin, ymin, xmax, ymax };
+	return xmin <= xmax;
+}
+
+internal void
+scalar_extract_ink(u8 *dst, const struct font *font, rect2i ink)
+{
+	i32 w = ink.x1 - ink.x0 + 1;
+	const u32 *src = font->bits + ink.y0 * font->bitmap_width + ink.x0;
+
+	for (i32 y = ink.y0; y <= ink.y1; ++y) {
+		for (i32 x = 0; x < w; ++x)
+			dst[x] = (u8)(src[x] & 0xFF);
+		src += font->bitmap_width;
+		dst += w;
+	}
+}
+
+internal void
+bench_rasterize(void)
+{
+	// latin, greek, cyrillic and the start of cjk.
+	u32 ranges[][2] = { { 0x20, 0x24F }, { 0x370, 0x4FF }, { 0x4E00, 0x51FF } };
+	i32 sizes[] = { 13, 32, 64 };
+
+	u8 *coverage = allocate<u8>(1 << 20);
+	for (i32 size : sizes) {
+		struct font *font = sys_create_font(L"Verdana", size);
+
+		i32 count = 0;
+		i64 checksum[2] = {};
+		double render = 0, kernels = 0, scalar = 0;
+
+		for (auto& range : ranges) {
+			for (u32 c = range[0]; c <= range[1]; ++c) {
+				u64 start = sys_ticks();
+				sys_render_glyph(font, c);
+				render += seconds_since(start);
+				++count;
+
+				// the bitmap stays the same, so both run on a warm cache.
+				rect2i ink;
+				start = sys_ticks();
+				if (ink_bounds(font->bits, font->bitmap_width, font->bitmap_height, &ink)) {
+					extract_ink(coverage, font, ink);
+					checksum[0] += coverage[0] + ink.x1 * ink.y1;
+				}
+				kernels += seconds_since(start);
+
+				start = sys_ticks();
+				if (scalar_ink_bounds(font->bits, font->bitmap_width, font->bitmap_height, &ink)) {
+					scalar_extract_ink(coverage, font, ink);
+					checksum[1] += coverage[0] + ink.x1 * ink.y1;
+				}
+				scalar += seconds_since(start);
+			}
+		}
+
+		printf("rasterize %2dpx, %d glyphs, bitmap %dx%d: kernels %.0f glyphs/s (%.2f us/glyph), per pixel %.0f glyphs/s (%.2f us/glyph)%s\n",
+			size, count, font->bitmap_width, font->bitmap_height,
+			count / (render + kernels), kernels * 1e6 / count,
+			count / (render + scalar), scalar * 1e6 / count,
+			checksum[0] != checksum[1] ? " (mismatch)" : "");
+	}
+}
+
+////////
+//
+// arrays: one item appends to array against std::vector and the array
+// before it grew in place, which doubled from one item with a copy each
+// time.
+
+template<typename T>
+struct copying_array
+{
+	i32 limit;
+	i32 count;
+	T *data;
+
+	friend T *allocate_n(copying_array& a, i32 n)
+	{
+		if (i32 m = a.count + n; m > a.limit) {
+			i32 limit = max(a.limit * 2, m);
+			T *data = allocate<T>((size_t)limit);
+			copy_n(a.count, data, a.data);
+			if (a.data)
+				sys_deallocate(a.data, (size_t)a.limit * sizeof(T), alignof(T));
+			a.limit = limit;
+			a.data = data;
+		}
+
+		T *result = a.data + a.count;
+		a.count += n;
+		return result;
+	}
+};
+
+template<typename T>
+internal inline T
+item_at(i32 i)
+{
+	T item = {};
+	item.x0 = (decltype(T::x0))i;
+	return item;
+}
+
+// best of runs, in millions of appends a second.
+template<typename T>
+internal void
+bench_appends(const char *name)
+{
+	const i32 count = 1 << 20;
+	const i32 runs = 20;
+	double best[3] = {};
+
+	for (i32 run = 0; run < runs; ++run) {
+		u64 start = sys_ticks();
+		array<i32, T> a = {};
+		for (i32 i = 0; i < count; ++i)
+			*allocate_n(a, 1) = item_at<T>(i);
+		double t = seconds_since(start);
+		best[0] = max(best[0], count / t);
+		sys_deallocate(a.data, (size_t)a.limit * sizeof(T), alignof(T));
+
+		start = sys_ticks();
+		{
+			std::vector<T> v;
+			for (i32 i = 0; i < count; ++i)
+				v.push_back(item_at<T>(i));
+		}
+		t = seconds_since(start);
+		best[1] = max(best[1], count / t);
+
+		start = sys_ticks();
+		copying_array<T> c = {};
+		for (i32 i = 0; i < count; ++i)
+			*allocate_n(c, 1) = item_at<T>(i);
+		t = seconds_since(start);
+		best[2] = max(best[2], count / t);
+		sys_deallocate(c.data, (size_t)c.limit * sizeof(T), alignof(T));
+	}
+
+	printf("arrays %-7s %2d bytes: array %4.0f M/s, std::vector %4.0f M/s, copying array %4.0f M/s\n",
+		name, (i32)sizeof(T), best[0] / 1e6, best[1] / 1e6, best[2] / 1e6);
+}
+
+internal void
+bench_arrays(void)
+{
+	bench_appends<quad>("quads");
+	bench_appends<glyph>("glyphs");
+}
+
+////////
+//
+// sdf: coverage error of the distance field font drawn at other sizes,
+// and of unhinted platform bitmaps rasterized at each size, over the
+// printable ascii glyphs. the reference is the exact area coverage of the
+// outline from the code's own rasterizer. the error is the mean absolute
+// coverage difference over pixels either side inks.
+
+// a glyph rasterized by the code with the pen at the origin.
+struct bench_glyph
+{
+	rect2i ink;
+	i32 w, h;
+	u8 *coverage;
+};
+
+internal bool
+rasterize_reference(const struct font *font, u32 codepoint, glyph_outline& o, bench_glyph *g)
+{
+	outline_codepoint(font, codepoint, o);
+	if (is_empty(o.lines))
+		return false;
+
+	g->ink = outline_ink(font, o);
+	g->w = g->ink.x1 - g->ink.x0 + 1;
+	g->h = g->ink.y1 - g->ink.y0 + 1;
+	g->coverage = allocate<u8>((size_t)(g->w * g->h));
+	rasterize_outline(font, o, g->ink, g->coverage, g->w);
+	return true;
+}
+
+internal inline f32
+texel(const u8 *p, i32 w, i32 h, i32 x, i32 y)
+{
+	return x >= 0 && x < w && y >= 0 && y < h ? (f32)p[y * w + x] / 255.f : 0.f;
+}
+
+// what the sdf shader samples at a point in the pixels of the field font.
+internal f32
+sample_field(const bench_glyph& field, i32 spread, f32 u, f32 v)
+{
+	f32 fx = u - (f32)(field.ink.x0 - spread) - .5f;
+	f32 fy = v - (f32)(field.ink.y0 - spread) - .5f;
+	i32 x = floor_i32(fx);
+	i32 y = floor_i32(fy);
+	f32 tx = fx - (f32)x;
+	f32 ty = fy - (f32)y;
+
+	i32 w = field.w + 2 * spread;
+	i32 h = field.h + 2 * spread;
+	f32 a = texel(field.coverage, w, h, x, y) * (1 - tx) + texel(field.coverage, w, h, x + 1, y) * tx;
+	f32 b = texel(field.coverage, w, h, x, y + 1) * (1 - tx) + texel(field.coverage, w, h, x + 1, y + 1) * tx;
+	return (a * (1 - ty) + b * ty) - .5f;
+}
+
+// coverage the sdf shader produces for pixel (x, y) of text drawn k times
+// the size of the field font.
+internal f32
+field_coverage(const bench_glyph& field, i32 spread, f32 k, i32 x, i32 y)
+{
+	f32 d = sample_field(field, spread, ((f32)x + .5f) / k, ((f32)y + .5f) / k);
+	f32 dx = sample_field(field, spread, ((f32)x + 1.5f) / k, ((f32)y + .5f) / k) - d;
+	f32 dy = sample_field(field, spread, ((f32)x + .5f) / k, ((f32)y + 1.5f) / k) - d;
+	f32 w = max(square_root(dx * dx + dy * dy), 1.f / 4096.f);
+	return min(max(d / w + .5f, 0.f), 1.f);
+}
+
+internal void
+bench_sdf(void)
+{
+	char path[1024];
+	i32 index = 0;
+	ttf_font *t = allocate<ttf_font>(1, ALLOCATE_ZERO);
+	if (!sys_find_font_file(L"Verdana", path, sizeof(path), &index) || !load_truetype(*t, path, index)) {
+		printf("sdf: no truetype font for Verdana\n");
+		return;
+	}
+
+	glyph_outline o = {};
+	struct font field_font = {};
+	field_font.ttf = t;
+	field_font.pixel_height = SDF_FONT_SIZE;
+
+	// one field per glyph, like the sdf atlas holds.
+	const i32 spread = SDF_SPREAD;
+	bench_glyph fields[128] = {};
+	i64 field_texels = 0;
+	for (u32 c = '!'; c <= '~'; ++c) {
+		bench_glyph& f = fields[c];
+		if (!rasterize_reference(&field_font, c, o, &f))
+			continue;
+
+		u8 *field = allocate<u8>((size_t)((f.w + 2 * spread) * (f.h + 2 * spread)));
+		make_distance_field(field, f.coverage, f.w, f.h, spread);
+		f.coverage = field;
+		field_texels += (f.w + 2 * spread) * (f.h + 2 * spread);
+	}
+
+	printf("sdf %s, field font %d px, spread %d, %lld field texels\n", path,
+		SDF_FONT_SIZE * FONT_DPI / 72, spread, (long long)field_texels);
+
+	// point sizes, so that the pixel sizes are whole.
+	i32 sizes[] = { 8, 12, 18, 24, 36, 72, 96 };
+	for (i32 size : sizes) {
+		struct font font = {};
+		font.ttf = t;
+		font.pixel_height = size;
+		f32 k = truetype_scale(*t, size) / truetype_scale(*t, SDF_FONT_SIZE);
+
+		struct font *bitmap_font = sys_create_font(L"Verdana", size);
+		// the platform renders fonts with a spread unhinted.
+		bitmap_font->sdf_spread = 1;
+
+		double bitmap_error = 0, field_error = 0;
+		i64 bitmap_pixels = 0, field_pixels = 0, bitmap_texels = 0;
+
+		for (u32 c = '!'; c <= '~'; ++c) {
+			bench_glyph g;
+			if (!rasterize_reference(&font, c, o, &g))
+				continue;
+
+			sys_render_glyph(bitmap_font, c);
+			i32 bx = bitmap_font->default_x;
+			i32 by = bitmap_font->default_y + bitmap_font->descent;
+			rect2i bitmap_ink;
+			if (ink_bounds(bitmap_font->bits, bitmap_font->bitmap_width, bitmap_font->bitmap_height, &bitmap_ink))
+				bitmap_texels += (bitmap_ink.x1 - bitmap_ink.x0 + 1) * (bitmap_ink.y1 - bitmap_ink.y0 + 1);
+
+			// everything either side could ink.
+			rect2i r = { g.ink.x0 - 2, g.ink.y0 - 2, g.ink.x1 + 2, g.ink.y1 + 2 };
+			r.x0 = min(r.x0, bitmap_ink.x0 - bx);
+			r.y0 = min(r.y0, bitmap_ink.y0 - by);
+			r.x1 = max(r.x1, bitmap_ink.x1 - bx);
+			r.y1 = max(r.y1, bitmap_ink.y1 - by);
+
+			for (i32 y = r.y0; y <= r.y1; ++y) {
+				for (i32 x = r.x0; x <= r.x1; ++x) {
+					f32 reference = texel(g.coverage, g.w, g.h, x - g.ink.x0, y - g.ink.y0);
+
+					i32 px = x + bx;
+					i32 py = y + by;
+					f32 bitmap = 0;
+					if (px >= 0 && px < bitmap_font->bitmap_width && py >= 0 && py < bitmap_font->bitmap_height)
+						bitmap = (f32)(bitmap_font->bits[py * bitmap_font->bitmap_width + px] & 0xFF) / 255.f;
+					f32 field = field_coverage(fields[c], spread, k, x, y);
+
+					if (reference > 0 || bitmap > 0) {
+						bitmap_error += bitmap > reference ? bitmap - reference : reference - bitmap;
+						++bitmap_pixels;
+					}
+					if (reference > 0 || field > 0) {
+						field_error += field > reference ? field - reference : reference - field;
+						++field_pixels;
+					}
+				}
+			}
+
+			sys_deallocate(g.coverage, (size_t)(g.w * g.h), alignof(u8));
+		}
+
+		printf("sdf %3d px: bitmap %6lld texels, error %5.2f%%, sdf error %5.2f%%\n",
+			size * FONT_DPI / 72, (long long)bitmap_texels,
+			100. * bitmap_error / (double)bitmap_pixels, 100. * field_error / (double)field_pixels);
+	}
+}
+
+////////
+//
+// truetype: single thread glyph throughput of the code's truetype
+// rasterizer against rendering through the platform, printable ascii and
+// latin-1. both produce the coverage of the inked rectangle.
+
+internal void
+bench_truetype(void)
+{
+	char path[1024];
+	i32 index = 0;
+	ttf_font *t = allocate<ttf_font>(1, ALLOCATE_ZERO);
+	if (!sys_find_font_file(L"Verdana", path, sizeof(path), &index) || !load_truetype(*t, path, index)) {
+		printf("truetype: no truetype font for Verdana\n");
+		return;
+	}
+
+	u32 codepoints[256];
+	i32 count = 0;
+	for (u32 c = ' '; c <= '~'; ++c)
+		codepoints[count++] = c;
+	for (u32 c = 0xA0; c <= 0xFF; ++c)
+		codepoints[count++] = c;
+
+	const i32 passes = 20;
+	glyph_outline o = {};
+	u8 *coverage = allocate<u8>(1 << 20);
+
+	printf("truetype %s, %d glyphs\n", path, count);
+
+	i32 sizes[] = { 10, 18, 36 };
+	for (i32 size : sizes) {
+		struct font font = {};
+		font.ttf = t;
+		font.pixel_height = size;
+
+		struct font *platform = sys_create_font(L"Verdana", size);
+
+		double best[2] = { 1e9, 1e9 };
+		for (i32 pass = 0; pass < passes; ++pass) {
+			u64 start = sys_ticks();
+			for (i32 i = 0; i < count; ++i) {
+				outline_codepoint(&font, codepoints[i], o);
+				if (!is_empty(o.lines)) {
+					rect2i ink = outline_ink(&font, o);
+					rasterize_outline(&font, o, ink, coverage, ink.x1 - ink.x0 + 1);
+				}
+			}
+			best[0] = min(best[0], seconds_since(start));
+
+			start = sys_ticks();
+			for (i32 i = 0; i < count; ++i) {
+				sys_render_glyph(platform, codepoints[i]);
+				rect2i ink;
+				if (ink_bounds(platform->bits, platform->bitmap_width, platform->bitmap_height, &ink))
+					extract_ink(coverage, platform, ink);
+			}
+			best[1] = min(best[1], seconds_since(start));
+		}
+
+		printf("truetype %2d pt %3d px: truetype %5.1fk glyphs/s, platform %5.1fk glyphs/s\n",
+			size, size * FONT_DPI / 72, count / best[0] / 1e3, count / best[1] / 1e3);
+	}
+}
+
+////////
+//
+// layout: cpu cost of drawing a 6000 character paragraph per frame, laid
+// out every frame or found in the layout cache, without kerning, kerned
+// with a cold pair cache and kerned with a warm one.
+
+enum layout_mode
+{
+	LAYOUT_UNKERNED,
+	LAYOUT_COLD_PAIRS,
+	LAYOUT_KERNED,
+};
+
+// average microseconds per frame, the best of several runs.
+internal double
+time_paragraph(app_state *state, const char *text, size_t n, layout_mode mode, bool relayout)
+{
+	const i32 frames = 50;
+	struct font *font = state->ui_font;
+	ttf_font *ttf = font->ttf;
+	vec4 color = { 1, 1, 1, 1 };
+
+	if (mode == LAYOUT_UNKERNED)
+		font->ttf = 0;
+
+	double best = 1e9;
+	for (i32 run = 0; run < 5; ++run) {
+		double total = 0;
+		for (i32 frame = -1; frame < frames; ++frame) {
+			if (relayout)
+				invalidate_layouts(state->layouts);
+			if (mode == LAYOUT_COLD_PAIRS)
+				fill_n(KERN_CACHE_SIZE, state->layouts.kerning, kern_entry{});
+
+			u64 start = sys_ticks();
+			draw_text(state, font, text, n, { 10, 1000 }, color);
+			// the first frame only warms up.
+			if (frame >= 0)
+				total += seconds_since(start);
+
+			flush_batch(state);
+			++state->frame;
+		}
+		best = min(best, total * 1e6 / frames);
+	}
+
+	font->ttf = ttf;
+	return best;
+}
+
+internal void
+bench_layout(void)
+{
+	app_state *state = (app_state *)reload(0);
+
+	const char *words[] = {
+		"AVATAR", "Wave", "To", "Type", "yellow", "kerning", "of", "the", "LAYOUT", "cache",
+		"Fy", "P.", "glyph", "V.A.", "are", "rasterized", "once", "Tw", "We", "you",
+	};
+	const size_t n = 6000;
+	char *text = allocate<char>(n + 64);
+	size_t at = 0, line = 0;
+	u32 random = 7;
+	while (at < n) {
+		const char *w = words[next_random(random) % (sizeof(words) / sizeof(*words))];
+		size_t len = strlen(w);
+		copy_n(len, text + at, w);
+		at += len;
+		line += len + 1;
+		text[at++] = line > 80 ? '\n' : ' ';
+		if (line > 80)
+			line = 0;
+	}
+
+	const char *modes[] = { "unkerned", "kerned, cold pair cache", "kerned" };
+	for (i32 mode = LAYOUT_UNKERNED; mode <= LAYOUT_KERNED; ++mode) {
+		double relayout = time_paragraph(state, text, n, (layout_mode)mode, true);
+		double cached = time_paragraph(state, text, n, (layout_mode)mode, false);
+		printf("layout %-24s every frame %6.1f us, cached %5.1f us\n", modes[mode], relayout, cached);
+	}
+}
+
+////////
+//
+// panels: render time of the 4x4 console panels at 3840x2160, scrolling
+// every frame. the panels are recorded by the render thread and every
+// worker, so sweep the thread count from the command line:
+// for n in 0 1 3 7 15; do bench panels $n; done
+
+internal void
+bench_panels(void)
+{
+	app_state *state = (app_state *)reload(0);
+	keyboard(state, KEY_FILL_CONSOLE);
+	keyboard(state, KEY_TOGGLE_PANELS);
+
+	// the first frames rasterize what the panels show.
+	for (i32 i = 0; i < 10; ++i)
+		render(state, 3840, 2160);
+
+	const i32 frames = 300;
+	u64 total = 0;
+	for (i32 i = 0; i < frames; ++i) {
+		mouse(state, 100, 1000, i % 2 ? -120 : 120, 0);
+		u64 start = sys_ticks();
+		render(state, 3840, 2160);
+		total += sys_ticks() - start;
+	}
+
+	printf("panels %2d threads: render avg %4.0f us, recorded by %d threads\n", state->workers.count + 1,
+		(double)total / (double)sys_tick_frequency() * 1e6 / frames, state->panels.threads);
+}
+
+////////
+
+struct benchmark
+{
+	const char *name;
+	void (*run)(void);
+};
+
+static benchmark global_benchmarks[] = {
+	{ "glyph_map", bench_glyph_map },
+	{ "rasterize", bench_rasterize },
+	{ "arrays", bench_arrays },
+	{ "sdf", bench_sdf },
+	{ "truetype", bench_truetype },
+	{ "layout", bench_layout },
+	{ "panels", bench_panels },
+};
+
+int
+main(int argc, char **argv)
+{
+	i32 found = 0;
+	for (benchmark& b : global_benchmarks) {
+		if (argc < 2 || strcmp(argv[1], b.name) == 0) {
+			if (!found++)
+				start_harness(argc > 2 ? atoi(argv[2]) : (i32)sysconf(_SC_NPROCESSORS_ONLN) - 1);
+			b.run();
+		}
+	}
+
+	if (!found) {
+		fprintf(stderr, "usage: bench [name [workers]]\nbenchmarks:");
+		for (benchmark& b : global_benchmarks)
+			fprintf(stderr, " %s", b.name);
+		fprintf(stderr, "\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# cpu use of the frame pacing modes, headless. run from a directory the
+# fonts resolve from, with the path of the built main, e.g.
+#   bench/pacing.sh _build/main
+
+main=${1:-./main}
+size="--width 800 --height 700"
+
+run() {
+	printf '%s: ' "$1"
+	shift
+	"$main" --headless $size "$@" 2>&1 | grep '^cpu\|^frames' | tr '\n' ' '
+	echo
+}
+
+file=$(mktemp)
+trap 'rm -f "$file"' EXIT
+seq 1000 > "$file"
+
+run "unpaced, 30 frames" --frames 30
+run "fixed 60 fps, 5 s" --fps 60 --seconds 5
+run "fixed 30 fps, 5 s" --fps 30 --seconds 5
+run "on demand, 5 s" --fps 0 --seconds 5
+run "on demand, file open, 3 s" --fps 0 --seconds 3 --open "$file"
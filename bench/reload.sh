@@ -0,0 +1,23 @@
+#!/bin/sh
+# reload latency. runs the headless build on demand and rebuilds the code
+# module a few times while it runs; the platform prints every reload. run
+# from a directory the fonts resolve from, with the build directory, e.g.
+#   bench/reload.sh _build
+
+build=${1:-.}
+source_dir=$(cd "$(dirname "$0")/.." && pwd)
+reloads=${2:-4}
+seconds=$((reloads * 12 + 5))
+
+"$build/main" --headless --fps 0 --seconds "$seconds" --width 800 --height 700 > reload.log 2>&1 &
+pid=$!
+
+for i in $(seq "$reloads"); do
+	sleep 5
+	touch "$source_dir/code.cpp"
+	cmake --build "$build" --target code > /dev/null
+done
+
+wait "$pid"
+grep '^reloaded\|^cpu' reload.log
+rm -f reload.log
@@ -0,0 +1,25 @@
+#!/bin/sh
+# time from start to the first frame, without and with the glyph cache.
+# run from a directory the fonts resolve from, with the path of the built
+# main, e.g.
+#   bench/startup.sh _build/main
+
+main=${1:-./main}
+runs=${2:-5}
+
+first_frame() {
+	"$main" --headless --frames 1 --width 800 --height 700 2>&1 | grep '^load'
+}
+
+echo cold:
+for i in $(seq "$runs"); do
+	rm -f glyph_cache.bin
+	first_frame
+done
+
+echo cached:
+for i in $(seq "$runs"); do
+	first_frame
+done
+
+rm -f glyph_cache.bin
@@ -1,14 +1,21 @@
 
+#define CODE_MODULE
 #include "shared.h"
 
-#define API_EXPORT extern "C" __declspec(dllexport)
+#define X(ret, name, ...)	\
+API_EXPORT ret (*name)(__VA_ARGS__);
+
+OPENGL_FUNCTIONS
+#undef X
 
+extern "C" {
 #define X(ret, name, ...)	\
-API_EXPORT ret (*name)(__VA_ARGS__) = 0;
+ret (*name)(__VA_ARGS__) = 0;
 
 OPENGL_FUNCTIONS
 SYSTEM_FUNCTIONS
 #undef X
+}
 
 ////////
 
@@ -24,54 +31,691 @@ struct vec4
 };
 
 struct rect2d { f32 x0, y0, x1, y1; };
+struct rect2i { i32 x0, y0, x1, y1; };
 
-struct vertex
+// one instance per rectangle. the vertex shader expands it into the four
+// corners of a triangle strip, so a glyph costs 20 bytes instead of six
+// full vertices.
+struct quad
 {
-	vec3 position;
-	vec2 texcoord;
-	vec4 color;
+	i16 x0, y0, x1, y1;	// position in pixels
+	u16 u0, v0, u1, v1;	// atlas rectangle in texels
+	u32 color;		// rgba8
 };
 
-using vertex_buffer = array<i32, vertex>;
+#ifndef ATLAS_UPLOAD_PBO
+#define ATLAS_UPLOAD_PBO	1
+#endif
 
-struct app_state
+#define BLEND_NONE		0
+#define BLEND_PREMULTIPLIED	1
+
+// a run of quads drawn with the same pipeline state.
+struct draw_command
+{
+	u32 program;
+	u32 texture;
+	u32 blend;
+
+	i32 first;
+	i32 count;
+};
+
+struct batch_stats
+{
+	i32 draw_count;
+	i32 quad_count;
+	i64 upload_bytes;
+	i64 atlas_upload_bytes;
+};
+
+// number of regions the streaming vertex buffer is split into.
+#define STREAM_REGIONS	3
+
+// all 2d drawing of a frame is recorded into one render_batch. quads are
+// written in submission order straight into a mapped region of the vertex
+// buffer and every change of pipeline state opens a new draw_command.
+// flush_batch unmaps the region and issues the commands in submission order,
+// one draw per state change.
+//
+// the regions of vbo are used round robin, one per frame. flushes within a
+// frame append to the current region, which is mapped unsynchronized past
+// the quads already drawn from it. finish_region fences it after the last
+// draw, so the cpu only waits if it laps the gpu by STREAM_REGIONS frames.
+struct render_batch
 {
-	u32 vao;
 	u32 vbo;
+	i32 region;
+	i32 region_limit;
+	i32 count;
+
+	// quads of the current region drawn by earlier flushes.
+	i32 offset;
+	u32 pad;
+
+	quad *quads;
+	void *fences[STREAM_REGIONS];
+
+	array<i32, draw_command> commands;
+
+	batch_stats stats;
+	batch_stats last_stats;
+};
+
+#define ATLAS_MAX_PAGES	4
+
+struct skyline_node
+{
+	i32 x;
+	i32 y;
+	i32 width;
+};
+
+struct atlas_page
+{
+	u32 texture;
+	i32 size;
+
+	// coverage, one byte per texel.
+	u8 *bits;
+
+	// top edge of the packed area, sorted by x and covering the page width.
+	array<i32, skyline_node> skyline;
+
+	// texels changed since the last upload. empty when x0 >= x1.
+	rect2i dirty;
+
+	// texels covered by packed rectangles.
+	i64 used;
+};
+
+struct glyph_atlas
+{
+	atlas_page pages[ATLAS_MAX_PAGES];
+	i32 page_count;
+
+	// pages start at min_size and grow up to max_size. at most max_pages
+	// of max_size * max_size bytes are ever allocated.
+	i32 min_size;
+	i32 max_size;
+	i32 max_pages;
+
+	// glyphs not drawn for this many frames may be evicted.
+	u32 evict_age;
+
+	// when non zero uploads are staged through this pixel buffer so the
+	// copy into the texture can happen asynchronously.
+	u32 pbo;
+
+	// texture filter of the pages. coverage is drawn texel for texel,
+	// distance fields are interpolated.
+	i32 filter;
+	u32 pad;
+
+	i64 rasterized;
+	i64 evictions;
+	i32 repacks;
+	i32 growths;
+	i64 too_large;
+};
+
+// composite glyphs deeper than this are cut off.
+#define TTF_MAX_DEPTH	8
+// kerning subtables of GPOS past this many are ignored.
+#define TTF_MAX_PAIR_SUBTABLES	32
+
+// a pair adjustment subtable of GPOS and the lookup it belongs to. the
+// first subtable of a lookup that matches a pair applies.
+struct ttf_pair_subtable
+{
+	u32 offset;
+	i32 lookup;
+};
+
+struct ttf_font
+{
+	mapped_file file;
+
+	// offsets into the file of the unicode cmap subtable, and of the
+	// tables outlines are read from.
+	u32 cmap;
+	u32 loca;
+	u32 glyf;
+	u32 glyf_size;
+	u32 hmtx;
+
+	i32 glyph_count;
+	i32 units_per_em;
+
+	// glyphs with an advance of their own in hmtx. the rest share the
+	// last one.
+	i32 long_metrics;
+
+	// loca holds u32 offsets, otherwise u16 offsets divided by 2.
+	bool long_offsets;
+	u8 pad[3];
+
+	i32 ascender;
+	i32 descender;
+	i32 line_gap;
+	i32 advance_max;
+
+	// kerning comes from the pair adjustments of the kern feature in GPOS,
+	// or from the format 0 pairs of the kern table when there are none.
+	ttf_pair_subtable pair_subtables[TTF_MAX_PAIR_SUBTABLES];
+	i32 pair_subtable_count;
+	u32 kern_pairs;
+	u32 kern_pair_count;
+};
+
+// maps font units to pixels, x' = xx * x + yx * y + dx and
+// y' = xy * x + yy * y + dy.
+struct ttf_transform
+{
+	f32 xx, xy;
+	f32 yx, yy;
+	f32 dx, dy;
+};
+
+struct outline_line
+{
+	f32 x0, y0;
+	f32 x1, y1;
+};
+
+// the lines of one glyph in pixels relative to the pen on the baseline, y
+// up, and their bounds. the arrays are scratch space reused from glyph to
+// glyph by one thread.
+struct glyph_outline
+{
+	array<i32, outline_line> lines;
+	f32 x0, y0, x1, y1;
+
+	array<i32, vec2> points;
+	array<i32, u8> on_curve;
+	array<i32, f32> area;
+};
+
+#define MAX_FONTS		16
+#define GLYPH_QUEUE_SIZE	1024
+
+// most glyphs in flight when render_glyph queues another job; past it they
+// are rasterized right away. a job holds at least one glyph in flight, so
+// this bounds the glyph jobs in the platform's work ring, which holds 1023
+// entries and also takes the panel and file index jobs.
+#define GLYPH_JOBS_MAX		512
+
+// a glyph rasterized by a worker. the render thread allocates one per
+// request and gets it back through glyph_workers::results.
+struct glyph_result
+{
+	struct glyph_workers *workers;
+	glyph_result *next;	// next glyph of the same job
+
+	struct font *font;
+	i32 font_index;
+	u32 codepoint;
+
+	i32 xadv;
+	u32 has_ink;
+
+	// inked part of the bitmap and its coverage, one byte per pixel.
+	rect2i ink;
+	u8 *coverage;
+};
+
+struct glyph_workers
+{
+	mpmc_queue<glyph_result *, GLYPH_QUEUE_SIZE> results;
+
+	// instances of every platform font per worker, created on first use.
+	font *fonts[MAX_FONTS][MAX_WORKER_THREADS + 1];
+
+	// scratch space of every worker for truetype outlines.
+	struct glyph_outline outlines[MAX_WORKER_THREADS + 1];
+
+	// number of worker threads. without any glyphs are rasterized on the
+	// render thread.
+	i32 count;
+
+	// requested glyphs that have not been received yet.
+	i32 in_flight;
+};
+
+// frames whose gpu timestamps can be in flight. a frame's queries are read
+// back up to GPU_TIMER_FRAMES frames later, when the gpu is normally done
+// with them, so reading them never waits.
+#define GPU_TIMER_FRAMES	4
+#define GPU_MAX_PASSES		8
+
+// timestamps taken at the pass boundaries of one frame.
+struct gpu_frame
+{
+	u32 queries[GPU_MAX_PASSES + 1];
+	i32 pass_count;
+	const char *names[GPU_MAX_PASSES];
+	u32 frame;
+	u32 pending;
+};
+
+struct gpu_timer
+{
+	gpu_frame frames[GPU_TIMER_FRAMES];
+	gpu_frame *current;
+
+	// gpu time of every pass of the last frame read back, in nanoseconds.
+	const char *names[GPU_MAX_PASSES];
+	u64 times[GPU_MAX_PASSES];
+	i32 pass_count;
+	u32 result_frame;
+
+	// frames whose queries were still not done when they had to be reused.
+	i32 dropped;
+
+	// appends every frame read back to GPU_LOG_FILE while set.
+	bool log;
+	u8 pad[3];
+
+	i32 log_used;
+	char log_buf[4096];
+};
+
+#if PROFILER
+
+////////
+//
+// profiler overlay. the events of every thread are read back once a frame
+// and summed per zone over PROFILE_WINDOW frames.
+
+#define PROFILE_WINDOW		32
+#define PROFILE_MAX_ZONES	32
+#define PROFILE_MAX_DEPTH	32
+
+struct zone_stats
+{
+	const char *name;
+	u64 ticks;
+	i32 count;
+	u32 pad;
+};
+
+struct profile_view
+{
+	u32 read[MAX_WORKER_THREADS + 1];
+	i32 depth[MAX_WORKER_THREADS + 1];
+	profile_event open[MAX_WORKER_THREADS + 1][PROFILE_MAX_DEPTH];
+
+	// the window being summed, and the last complete one, slowest first.
+	zone_stats zones[PROFILE_MAX_ZONES];
+	zone_stats shown[PROFILE_MAX_ZONES];
+	i32 zone_count;
+	i32 shown_count;
+	i32 frames;
+
+	bool export_trace;
+	u8 pad[3];
+};
+
+#endif
+
+#define PERMANENT_ARENA_SIZE	((size_t)256 << 20)
+#define LAYOUT_CACHE_SIZE	1024
+#define LAYOUT_ATTEMPTS		4
+#define LAYOUT_EVICT_AGE	60
+#define KERN_CACHE_SIZE		4096	// power of two
+
+struct layout_run
+{
+	i32 page;
+	i32 count;
+};
+
+// quads of a string relative to its origin, split into runs by atlas page.
+struct text_layout
+{
+	struct font *font;	// 0 for a free slot
+	u64 hash;
+	u32 color;
+	f32 scale;
+
+	u32 last_used;
+
+	// pen position after the text, relative to the origin.
+	i32 dx;
+	i32 dy;
+
+	// some glyph was still being rasterized, or the atlas kept moving the
+	// glyphs while the text was laid out.
+	bool pending;
+	u8 pad[3];
+
+	array<i32, quad> quads;
+	array<i32, i32> glyphs;	// index into font->glyphs of each quad
+	array<i32, layout_run> runs;
+};
+
+// kerning of a glyph pair in pixels. font is 0 for an empty entry.
+struct kern_entry
+{
+	struct font *font;
+	u32 pair;
+	i32 kerning;
+};
+
+struct layout_cache
+{
+	text_layout slots[LAYOUT_CACHE_SIZE];
+	text_layout scratch;
+
+	// pairs kerned recently, so laying out text again rarely has to look
+	// them up in the font.
+	kern_entry kerning[KERN_CACHE_SIZE];
+
+	// slots by layout_key.
+	index_map<i32> map;
+
+	i32 free_slots[LAYOUT_CACHE_SIZE];
+	i32 free_count;
+
+	// bumped whenever all layouts are dropped.
+	u32 generation;
+
+	i32 hits;
+	i32 misses;
+	i32 last_hits;
+	i32 last_misses;
+};
+
+// both must be powers of two.
+#define CONSOLE_TEXT_SIZE	((size_t)1 << 30)
+#define CONSOLE_MAX_LINES	((size_t)1 << 24)
+#define CONSOLE_MAX_LINE	1024
+
+struct text_console
+{
+	arena text_arena;
+	arena line_arena;
+
+	u8 *text;
+
+	// where each line starts in the text stream, by line number.
+	u64 *lines;
+
+	// bytes appended so far.
+	u64 head;
+
+	// numbers of the oldest line kept and one past the newest.
+	u64 first_line;
+	u64 line_end;
 
-	u32 basic_program;
-	i32 basic_uproj;
+	// the newest line has not ended yet.
+	bool open;
+	u8 pad[7];
+
+	// lines the view is scrolled back from the newest.
+	i64 scroll;
+
+	u64 appended_lines;
+	u64 append_ticks;
+};
+
+#define FILE_INDEX_STRIDE	64
+#define FILE_INDEX_CHUNK	((u64)4 << 20)
+#define FILE_INDEX_RESERVE	((size_t)1 << 31)
+// how often an open file is looked at for new lines when frames are only
+// rendered on demand.
+#define FILE_POLL_MS		250
+
+struct file_view
+{
+	mapped_file file;
+
+	// start of every FILE_INDEX_STRIDE-th line after the first, how many
+	// lines and bytes the index covers, and the ticks spent building it.
+	arena index_arena;
+	u64 *checkpoints;
+	volatile u64 checkpoint_count;
+	volatile u64 line_count;
+	volatile u64 indexed;
+	u64 index_ticks;
+
+	// an index job is running up to index_end.
+	volatile u32 indexing;
+	u32 pad;
+	u64 index_end;
+
+	// start of the line at the top of the view, and wheel lines that were
+	// not applied yet.
+	u64 top;
+	i64 scroll;
+	bool follow;
+	u8 pad2[7];
+
+	u64 open_ticks;
+	u64 first_frame_ticks;
+};
+
+#define PANEL_COLUMNS		4
+#define PANEL_ROWS		4
+#define PANEL_GAP		6
+#define RECORD_QUADS_RESERVE	((size_t)16 << 20)
+#define RECORD_COMMANDS_RESERVE	((size_t)1 << 20)
+#define RECORD_MISSES_RESERVE	((size_t)1 << 20)
+// how long the render thread spins on the panels of other threads before
+// it yields.
+#define PANEL_SPINS		1024
+
+// what one thread recorded during a frame. the arenas are reset at the
+// start of every frame with panels and only ever grow from one thread.
+struct panel_recorder
+{
+	arena quads;
+	arena commands;
+	arena misses;	// codepoints without a glyph
+
+	i64 utf8_errors;
+	i32 panels;
+	u32 pad;
+
+	// a kern cache of its own, the one of the layouts is not shared.
+	kern_entry kerning[KERN_CACHE_SIZE];
+};
+
+// the panels of a frame and what records them. it lives as long as the
+// state: a job no worker started during the frame stays queued until one
+// does, and then finds every panel claimed.
+struct panel_job
+{
+	struct app_state *state;
+	struct panel *panels;
+	i32 count;
+
+	u32 color;
+	u32 faint;
+
+	// jobs in the work queue, at most one per worker.
+	volatile u32 queued;
+
+	// the next panel to claim, and the panels recorded so far.
+	volatile u32 next;
+	volatile u32 done;
+};
+
+struct panel_view
+{
+	bool on;
+	u8 pad[3];
+
+	// threads that recorded a panel in the last frame.
+	i32 threads;
+	u64 record_ticks;
+	u64 merge_ticks;
+
+	panel_job job;
+	panel_recorder recorders[MAX_WORKER_THREADS + 1];
+};
+
+#define FRAME_ARENA_SIZE	((size_t)256 << 20)
+#define STATE_ARENA_SIZE	((size_t)16 << 20)
+
+struct app_state
+{
+	// STATE_LAYOUT of the code that created it. always first, so any
+	// version of the code can read it.
+	u64 layout;
+
+	// holds whatever outlives app_state when migrate carries it to new
+	// code: the fonts and the carried_state.
+	arena permanent_arena;
+
+	// holds app_state itself and whatever lives as long as it. migrate
+	// releases it.
+	arena state_arena;
+
+	// reset at the start of every frame.
+	arena frame_arena;
+
+	// glyph_result blocks, carved from state_arena.
+	pool results;
+
+	// scratch space for truetype outlines rasterized on the render thread.
+	struct glyph_outline outline;
+
+	u32 vao;
 
 	u32 texture_program;
 	i32 texture_uproj;
 	i32 texture_umap;
 
-	u32 atlas;
-	i32 atlas_width;
-	i32 atlas_height;
-	u32 atlas_is_dirty;
+	u32 sdf_program;
+	i32 sdf_uproj;
+	i32 sdf_umap;
+
+	// of the shader sources the programs were compiled from.
+	u64 shader_hash;
+
+	// coverage glyphs, and distance field glyphs of fonts with an
+	// sdf_spread.
+	glyph_atlas atlas;
+	glyph_atlas sdf_atlas;
 
-	i32 atlas_ymax;
-	i32 atlas_x;
-	i32 atlas_y;
+	render_batch batch;
 
-	u32 *atlas_bits;
+	glyph_workers workers;
 
-	vertex_buffer vertices;
+	gpu_timer gpu;
 
+	layout_cache layouts;
+
+	text_console console;
+	file_view file;
+	panel_view panels;
+
+	array<i32, font *> fonts;
 	font *console_font;
 	font *ui_font;
 
+	// drawn at sdf_scale times its size. the wheel zooms it below the
+	// console.
+	font *sdf_font;
+	f32 sdf_scale;
+
+	// fonts that took over their glyphs from GLYPH_CACHE_FILE, when it was
+	// last written and how many glyphs had been rasterized by then.
+	i32 cached_fonts;
+	u32 pad;
+	u64 cache_saved;
+	i64 cache_rasterized;
+
 	i32 mouse_x;
 	i32 mouse_y;
 	u32 mouse_buttons;
 
-	u32 pad;
+	u32 frame;
+
+	// malformed utf-8 sequences laid out so far.
+	i64 utf8_errors;
+
+	// cpu time between the starts of the last two frames, and spent in
+	// the last call to render.
+	u64 frame_start;
+	u64 frame_ticks;
+	u64 render_ticks;
+	u64 tick_frequency;
+
+#if PROFILER
+	profile_view profile;
+#endif
 
 	// debug
 	vec2 debug_cursor;
 };
 
+////////
+//
+// state versions. a reload keeps app_state as it is when the new code lays
+// it out the same way. otherwise the old code frees its gpu objects and
+// packs what is slow to rebuild into a carried_state, which the new code
+// takes over when it agrees on that layout: the fonts and their glyphs,
+// the atlas bits, the console and the open file. everything else starts
+// over.
+//
+// the layouts hash the sizes of the structs involved, which catches most
+// changes. bump the versions for the rest.
+
+#define APP_STATE_VERSION	1
+#define CARRIED_STATE_VERSION	1
+
+// "carried\0"
+#define CARRIED_STATE_TAG	0x0064656972726163ull
+
+struct carried_state
+{
+	// CARRIED_STATE_TAG where app_state has its layout, then CARRIED_LAYOUT.
+	u64 tag;
+	u64 layout;
+
+	// carried_state itself lives in it.
+	arena permanent_arena;
+
+	glyph_atlas atlas;
+	glyph_atlas sdf_atlas;
+
+	text_console console;
+	file_view file;
+
+	font *fonts[MAX_FONTS];
+	font *worker_fonts[MAX_FONTS][MAX_WORKER_THREADS + 1];
+	i32 font_count;
+	i32 console_font;
+	i32 ui_font;
+	i32 sdf_font;
+	f32 sdf_scale;
+	u32 pad;
+};
+
+template<size_t N>
+constexpr u64
+layout_hash(const u64 (&sizes)[N])
+{
+	u64 h = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < N; ++i)
+		h = (h ^ sizes[i]) * 0x100000001B3ull;
+	return h;
+}
+
+static constexpr u64 CARRIED_LAYOUT = layout_hash({
+	CARRIED_STATE_VERSION, sizeof(carried_state), sizeof(arena), sizeof(glyph_atlas),
+	sizeof(atlas_page), sizeof(text_console), sizeof(file_view), sizeof(font),
+	sizeof(glyph), sizeof(ttf_font),
+});
+
+static constexpr u64 STATE_LAYOUT = layout_hash({
+	CARRIED_LAYOUT, APP_STATE_VERSION, sizeof(app_state), sizeof(render_batch),
+	sizeof(glyph_workers), sizeof(gpu_timer), sizeof(layout_cache), sizeof(text_layout),
+	sizeof(panel_view),
+});
+
 ////////
 //
 // formating.
@@ -107,7 +751,7 @@ to_string(char *f, char *l, u64 num, u32 base = 10, ptrdiff_t minwidth = 0, char
 		*p++ = "0123456789ABCDEF"[num % base];
 	while (num /= base);
 
-	ptrdiff_t n = max(0LL, minwidth - (p - digits));
+	ptrdiff_t n = max((ptrdiff_t)0, minwidth - (p - digits));
 	f = fill_n(min(n, l - f - 1), f, fillchar);
 
 	while (p != digits && f + 1 != l)
@@ -217,6 +861,13 @@ round(f32 x)
     return (f32)(i32)(x + 0.5f);
 }
 
+internal inline i32
+floor_i32(f32 x)
+{
+	i32 i = (i32)x;
+	return (f32)i > x ? i - 1 : i;
+}
+
 internal inline f32
 line_height(struct font *font)
 {
@@ -268,332 +919,4619 @@ opengl_uniform_location(u32 program, const char *name)
 }
 
 ////////
+//
+// glyph bitmap kernels. the platform renders glyphs into 32 bit pixels
+// with the coverage in the low byte. these find the inked area of such a
+// bitmap and extract the coverage into the atlas, 8 pixels at a time with
+// AVX2, 4 with SSE2, or one by one otherwise.
 
-internal struct glyph *
-render_glyph(struct app_state *state, struct font *font, u32 codepoint)
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE2 1
+#endif
+
+// index of the first and last non zero pixel in p[0, n), or -1 if all of
+// them are zero.
+internal i32
+first_nonzero(const u32 *p, i32 n)
 {
-	for (auto& g : font->glyphs)
-		if (g.codepoint == codepoint)
-			return &g;
+	i32 i = 0;
+
+#if SIMD_AVX2
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		u32 zero = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, _mm256_setzero_si256())));
+		if (zero != 0xFF)
+			return i + lowest_set_bit(~zero & 0xFF);
+	}
+#endif
+
+#if SIMD_SSE2
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		u32 zero = (u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_setzero_si128())));
+		if (zero != 0xF)
+			return i + lowest_set_bit(~zero & 0xF);
+	}
+#endif
 
-	glyph *g = allocate_n(font->glyphs, 1);
+	for (; i < n; ++i)
+		if (p[i])
+			return i;
 
-	g->codepoint = codepoint;
-	g->xadv = sys_render_glyph(font, codepoint);
-
-	i32 xmin = state->atlas_width;
-	i32 ymin = state->atlas_height;
-	i32 xmax = 0;
-	i32 ymax = 0;
-
-	u32 *p = font->bits;
-	for (i32 y = 0; y < font->bitmap_height; ++y) {
-		for (i32 x = 0; x < font->bitmap_width; ++x) {
-			if (*p) {
-				xmin = min(xmin, x);
-				xmax = max(x, xmax);
-				ymin = min(ymin, y);
-				ymax = max(y, ymax);
-			}
-			++p;
-		}
+	return -1;
+}
+
+internal i32
+last_nonzero(const u32 *p, i32 n)
+{
+	i32 i = n;
+
+#if SIMD_AVX2
+	for (; i >= 8; i -= 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i - 8));
+		u32 zero = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, _mm256_setzero_si256())));
+		if (zero != 0xFF)
+			return i - 8 + highest_set_bit(~zero & 0xFF);
+	}
+#endif
+
+#if SIMD_SSE2
+	for (; i >= 4; i -= 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i - 4));
+		u32 zero = (u32)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_setzero_si128())));
+		if (zero != 0xF)
+			return i - 4 + highest_set_bit(~zero & 0xF);
 	}
+#endif
 
-	if (xmin <= xmax) {
-		i32 w = xmax - xmin + 1;
-		i32 h = ymax - ymin + 1;
+	while (i--)
+		if (p[i])
+			return i;
 
-		if (state->atlas_x + w > state->atlas_width) {
-			state->atlas_x = 0;
-			state->atlas_y += state->atlas_ymax;
-			state->atlas_ymax = 0;
-		}
+	return -1;
+}
 
-		state->atlas_ymax = max(h, state->atlas_ymax);
+// bounding box of the non zero pixels of a bitmap, inclusive. returns
+// false for an empty bitmap. the inked rows are found from both ends, and
+// between them each row is only searched outside the extent found so far.
+internal bool
+ink_bounds(const u32 *bits, i32 width, i32 height, rect2i *result)
+{
+	i32 ymin = 0;
+	while (ymin < height && first_nonzero(bits + ymin * width, width) < 0)
+		++ymin;
 
-		g->dx = xmin - font->default_x;
-		g->dy = ymin - font->default_y;
-		g->x0 = state->atlas_x;
-		g->y0 = state->atlas_y;
-		g->x1 = g->x0 + w;
-		g->y1 = g->y0 + h;
+	if (ymin == height)
+		return false;
 
-		auto convert_pixel = [](u32 x) {
-			u32 c = x & 0xFF;
-			return (c << 24) | (c << 16) | (c << 8) | c;
-		};
+	i32 ymax = height - 1;
+	while (first_nonzero(bits + ymax * width, width) < 0)
+		--ymax;
 
-		u32 *src = font->bits + ymin * font->bitmap_width + xmin;
-		u32 *dst = state->atlas_bits + state->atlas_y * state->atlas_width + state->atlas_x;
+	i32 xmin = width;
+	i32 xmax = -1;
 
-		for (i32 y = 0; y < h; ++y) {
-			transform_n(w, dst, src, convert_pixel);
-			src += font->bitmap_width;
-			dst += state->atlas_width;
-		}
+	for (i32 y = ymin; y <= ymax; ++y) {
+		const u32 *row = bits + y * width;
 
-		state->atlas_x += w;
-		state->atlas_is_dirty = true;
-	}
-	else {
-		g->dx = 0;
-		g->dy = 0;
-		g->x0 = 0;
-		g->y0 = 0;
-		g->x1 = 0;
-		g->y1 = 0;
-	}
+		i32 left = first_nonzero(row, xmin);
+		if (left >= 0)
+			xmin = left;
 
-	return g;
-}
+		i32 right = last_nonzero(row + xmax + 1, width - xmax - 1);
+		if (right >= 0)
+			xmax += 1 + right;
+	}
 
-internal inline void
-upload_vertices(app_state *state)
-{
-	glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
-	glBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)(sizeof(vertex) * state->vertices.count), state->vertices.data, GL_STREAM_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	*result = { xmin, ymin, xmax, ymax };
+	return true;
 }
 
+// copies the low byte of n pixels.
 internal void
-mesh_rect2d(vertex_buffer& vertices, f32 x0, f32 y0, f32 x1, f32 y1, f32 z, f32 u0, f32 v0, f32 u1, f32 v1, vec4 color)
+extract_coverage(u8 *dst, const u32 *src, i32 n)
 {
-	vertex *v = allocate_n(vertices, 6);
-
-	v[0] = { { x0, y0, z }, { u0, v0 }, color };
-	v[1] = { { x1, y0, z }, { u1, v0 }, color };
-	v[2] = { { x0, y1, z }, { u0, v1 }, color };
+	i32 i = 0;
+
+#if SIMD_AVX2
+	__m256i mask8 = _mm256_set1_epi32(0xFF);
+	__m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	for (; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + i)), mask8);
+		__m256i b = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + i + 8)), mask8);
+		__m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + i + 16)), mask8);
+		__m256i d = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + i + 24)), mask8);
+
+		// packs work within 128 bit lanes, the permute puts the dwords
+		// back in pixel order.
+		__m256i ab = _mm256_packs_epi32(a, b);
+		__m256i cd = _mm256_packs_epi32(c, d);
+		__m256i abcd = _mm256_packus_epi16(ab, cd);
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(abcd, order));
+	}
+#endif
+
+#if SIMD_SSE2
+	__m128i mask4 = _mm_set1_epi32(0xFF);
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i)), mask4);
+		__m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 4)), mask4);
+		__m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 8)), mask4);
+		__m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 12)), mask4);
+
+		__m128i ab = _mm_packs_epi32(a, b);
+		__m128i cd = _mm_packs_epi32(c, d);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(ab, cd));
+	}
+#endif
 
-	v[3] = { { x1, y0, z }, { u1, v0 }, color };
-	v[4] = { { x1, y1, z }, { u1, v1 }, color };
-	v[5] = { { x0, y1, z }, { u0, v1 }, color };
+	for (; i < n; ++i)
+		dst[i] = (u8)(src[i] & 0xFF);
 }
 
-internal vec2
-draw_text(app_state *state, struct font *font, const char *s, vec2 cursor, f32 z, vec4 color)
+////////
+//
+// utf-8 decoding. runs of ascii are found 32 or 16 bytes at a time and
+// skip the decoder. malformed sequences decode to U+FFFD, one for each
+// maximal invalid subpart, the way the unicode standard recommends.
+
+#define UTF8_REPLACEMENT	0xFFFD
+
+struct utf8_reader
 {
-	f32 w = (f32)state->atlas_width;
-	f32 h = (f32)state->atlas_height;
+	const u8 *at;
+	const u8 *end;
+
+	// malformed sequences read so far.
+	i64 errors;
+};
 
-	clear(state->vertices);
+// length of the ascii run at the start of s[0, n).
+internal size_t
+ascii_prefix(const u8 *s, size_t n)
+{
+	size_t i = 0;
 
-	f32 x = round(cursor.x);
-	f32 y = round(cursor.y);
+#if SIMD_AVX2
+	for (; i + 32 <= n; i += 32) {
+		u32 high = (u32)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+		if (high)
+			return i + (size_t)lowest_set_bit(high);
+	}
+#endif
 
-	while (*s) {
-		u32 codepoint = (u32)*s;
+#if SIMD_SSE2
+	for (; i + 16 <= n; i += 16) {
+		u32 high = (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+		if (high)
+			return i + (size_t)lowest_set_bit(high);
+	}
+#endif
 
-		if (codepoint == '\n') {
-			y -= line_height(font);
-			x = round(cursor.x);
-		}
-		else {
-			struct glyph *glyph = render_glyph(state, font, codepoint);
-			if (glyph) {
-				f32 x0 = (f32)(x + glyph->dx);
-				f32 y0 = (f32)(y + glyph->dy);
-				f32 x1 = x0 + (glyph->x1 - glyph->x0);
-				f32 y1 = y0 + (glyph->y1 - glyph->y0);
+	while (i < n && s[i] < 0x80)
+		++i;
 
-				f32 u0 = glyph->x0 / w;
-				f32 v0 = glyph->y0 / h;
-				f32 u1 = glyph->x1 / w;
-				f32 v1 = glyph->y1 / h;
+	return i;
+}
 
-				mesh_rect2d(state->vertices, x0, y0, x1, y1, z, u0, v0, u1, v1, color);
+// decodes the codepoint at r.at, which must be before r.end.
+internal u32
+next_codepoint(utf8_reader& r)
+{
+	u32 c = *r.at++;
+	if (c < 0x80)
+		return c;
+
+	// the lead byte gives the length, and limits the range of the second
+	// byte so that overlong forms, surrogates and codepoints past U+10FFFF
+	// are rejected there.
+	i32 n;
+	u32 lo = 0x80;
+	u32 hi = 0xBF;
+
+	if (c >= 0xC2 && c <= 0xDF) {
+		n = 2;
+		c &= 0x1F;
+	}
+	else if (c >= 0xE0 && c <= 0xEF) {
+		n = 3;
+		if (c == 0xE0) lo = 0xA0;
+		if (c == 0xED) hi = 0x9F;
+		c &= 0x0F;
+	}
+	else if (c >= 0xF0 && c <= 0xF4) {
+		n = 4;
+		if (c == 0xF0) lo = 0x90;
+		if (c == 0xF4) hi = 0x8F;
+		c &= 0x07;
+	}
+	else {
+		++r.errors;
+		return UTF8_REPLACEMENT;
+	}
 
-				x += glyph->xadv;
-			}
+	for (i32 i = 1; i < n; ++i) {
+		if (r.at == r.end || *r.at < lo || *r.at > hi) {
+			++r.errors;
+			return UTF8_REPLACEMENT;
 		}
 
-		++s;
+		c = c << 6 | (*r.at++ & 0x3F);
+		lo = 0x80;
+		hi = 0xBF;
 	}
 
-	if (is_empty(state->vertices))
-		return cursor;
+	return c;
+}
 
-	if (state->atlas_is_dirty) {
-		glBindTexture(GL_TEXTURE_2D, state->atlas);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, state->atlas_width, state->atlas_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, state->atlas_bits);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		state->atlas_is_dirty = false;
-	}
+// length of the well formed prefix of s[0, n), which is n if all of it is
+// valid utf-8.
+internal size_t
+validate_utf8(const u8 *s, size_t n)
+{
+	utf8_reader r = { s, s + n, 0 };
 
-	upload_vertices(state);
+	for (;;) {
+		r.at += ascii_prefix(r.at, (size_t)(r.end - r.at));
+		if (r.at == r.end)
+			return n;
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-	glBindTexture(GL_TEXTURE_2D, state->atlas);
-	glUseProgram(state->texture_program);
-	glDrawArrays(GL_TRIANGLES, 0, state->vertices.count);
-	glUseProgram(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+		const u8 *start = r.at;
+		next_codepoint(r);
+		if (r.errors)
+			return (size_t)(start - s);
+	}
+}
+
+////////
+//
+// newline scanning, 32 or 16 bytes at a time.
+
+// offset of the first newline in p[0, n), or n if there is none.
+internal u64
+find_newline(const u8 *p, u64 n)
+{
+	u64 i = 0;
+
+#if SIMD_AVX2
+	__m256i newline8 = _mm256_set1_epi8('\n');
+	for (; i + 32 <= n; i += 32) {
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), newline8));
+		if (mask)
+			return i + (u64)lowest_set_bit(mask);
+	}
+#endif
+
+#if SIMD_SSE2
+	__m128i newline4 = _mm_set1_epi8('\n');
+	for (; i + 16 <= n; i += 16) {
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), newline4));
+		if (mask)
+			return i + (u64)lowest_set_bit(mask);
+	}
+#endif
+
+	while (i < n && p[i] != '\n')
+		++i;
+
+	return i;
+}
+
+// offset one past the last newline in p[0, n), or 0 if there is none.
+internal u64
+find_last_newline(const u8 *p, u64 n)
+{
+	u64 i = n;
+
+#if SIMD_AVX2
+	__m256i newline8 = _mm256_set1_epi8('\n');
+	for (; i >= 32; i -= 32) {
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i - 32)), newline8));
+		if (mask)
+			return i - 32 + (u64)highest_set_bit(mask) + 1;
+	}
+#endif
+
+#if SIMD_SSE2
+	__m128i newline4 = _mm_set1_epi8('\n');
+	for (; i >= 16; i -= 16) {
+		u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i - 16)), newline4));
+		if (mask)
+			return i - 16 + (u64)highest_set_bit(mask) + 1;
+	}
+#endif
+
+	while (i && p[i - 1] != '\n')
+		--i;
+
+	return i;
+}
+
+// newlines seen so far, and where every stride-th line starts.
+struct newline_counter
+{
+	u64 lines;
+	u64 stride;
+	u64 *checkpoints;
+	u64 checkpoint_count;
+};
+
+// counts the newlines of a block, given as a bit mask of the bytes from
+// offset at of the text.
+internal inline void
+count_block(newline_counter& c, u32 mask, u64 at)
+{
+	u64 k = (u64)population_count(mask);
+	u64 until = c.stride - c.lines % c.stride;
+	if (k < until) {
+		c.lines += k;
+		return;
+	}
+
+	for (; mask; mask &= mask - 1) {
+		if (++c.lines % c.stride == 0)
+			c.checkpoints[c.checkpoint_count++] = at + (u64)lowest_set_bit(mask) + 1;
+	}
+}
+
+// counts the newlines in p[0, n), where p is at offset base of the text.
+// single newlines are only looked at in blocks that complete a stride.
+internal void
+count_newlines(newline_counter& c, const u8 *p, u64 n, u64 base)
+{
+	u64 i = 0;
+
+#if SIMD_AVX2
+	__m256i newline8 = _mm256_set1_epi8('\n');
+	for (; i + 32 <= n; i += 32)
+		count_block(c, (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), newline8)), base + i);
+#endif
+
+#if SIMD_SSE2
+	__m128i newline4 = _mm_set1_epi8('\n');
+	for (; i + 16 <= n; i += 16)
+		count_block(c, (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), newline4)), base + i);
+#endif
+
+	for (; i < n; ++i)
+		if (p[i] == '\n')
+			count_block(c, 1, base + i);
+}
+
+////////
+//
+// truetype. fonts with glyf outlines are read straight from the mapped
+// font file and rasterized here, the same on every platform. a ttf_font is
+// never written after it is loaded, so any number of threads can rasterize
+// with it at once. outlines are flattened into lines, the signed area each
+// line covers is accumulated per pixel, and a running sum along every row
+// turns the area into coverage.
+
+internal inline f32
+square_root(f32 x)
+{
+#if SIMD_SSE2
+	return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(x)));
+#else
+	f32 r = x > 1.f ? x : 1.f;
+	for (i32 i = 0; i < 16; ++i)
+		r = .5f * (r + x / r);
+	return r;
+#endif
+}
+
+internal inline u32 read_u16(const u8 *p) { return (u32)p[0] << 8 | p[1]; }
+internal inline i32 read_i16(const u8 *p) { return (i16)read_u16(p); }
+internal inline u32 read_u32(const u8 *p) { return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3]; }
+
+#define TTF_TAG(a, b, c, d)	((u32)(a) << 24 | (u32)(b) << 16 | (u32)(c) << 8 | (u32)(d))
+
+// offset of a table of the font starting at offset font in the file, or 0
+// if it is missing or smaller than min_size.
+internal u32
+find_table(const mapped_file& file, u32 font, u32 tag, u32 min_size, u32 *size = 0)
+{
+	const u8 *d = file.data;
+	if ((u64)font + 12 > file.size)
+		return 0;
+
+	u32 count = read_u16(d + font + 4);
+	if ((u64)font + 12 + 16 * (u64)count > file.size)
+		return 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		const u8 *record = d + font + 12 + 16 * i;
+		if (read_u32(record) != tag)
+			continue;
+
+		u32 offset = read_u32(record + 8);
+		u32 length = read_u32(record + 12);
+		if (length < min_size || (u64)offset + length > file.size)
+			return 0;
+
+		if (size)
+			*size = length;
+		return offset;
+	}
+
+	return 0;
+}
+
+// picks a unicode subtable of format 12, or of format 4 if there is none.
+internal u32
+find_cmap_subtable(const mapped_file& file, u32 cmap, u32 cmap_size)
+{
+	const u8 *d = file.data;
+	u32 count = read_u16(d + cmap + 2);
+	if (4 + 8 * (u64)count > cmap_size)
+		return 0;
+
+	u32 best = 0;
+	u32 best_format = 0;
+
+	for (u32 i = 0; i < count; ++i) {
+		const u8 *record = d + cmap + 4 + 8 * i;
+		u32 platform = read_u16(record);
+		u32 encoding = read_u16(record + 2);
+		u32 offset = read_u32(record + 4);
+
+		bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+		if (!unicode || (u64)offset + 16 > cmap_size)
+			continue;
+
+		u32 subtable = cmap + offset;
+		u32 format = read_u16(d + subtable);
+		u64 size = 0;
+		if (format == 4)
+			size = 16 + 4 * (u64)read_u16(d + subtable + 6);
+		else if (format == 12)
+			size = 16 + 12 * (u64)read_u32(d + subtable + 12);
+		else
+			continue;
+
+		if ((u64)offset + size > cmap_size || format <= best_format)
+			continue;
+
+		best = subtable;
+		best_format = format;
+	}
+
+	return best;
+}
+
+// true if a kern feature of the GPOS feature list refers to the lookup.
+// the kern feature of every script and language counts.
+internal bool
+is_kern_lookup(const u8 *d, u32 features, u32 end, u32 lookup)
+{
+	u32 count = read_u16(d + features);
+	for (u32 i = 0; i < count; ++i) {
+		const u8 *record = d + features + 2 + 6 * i;
+		if (read_u32(record) != TTF_TAG('k', 'e', 'r', 'n'))
+			continue;
+
+		u32 feature = features + read_u16(record + 4);
+		if (feature + 4 > end)
+			continue;
+
+		u32 lookups = read_u16(d + feature + 2);
+		if (feature + 4 + 2 * lookups > end)
+			continue;
+
+		for (u32 j = 0; j < lookups; ++j)
+			if (read_u16(d + feature + 4 + 2 * j) == lookup)
+				return true;
+	}
+
+	return false;
+}
+
+// collects the pair adjustment subtables of the kern feature, in the
+// order of the lookup list, or the pairs of the first horizontal format 0
+// kern subtable if GPOS has none.
+internal void
+find_kerning(ttf_font& t, u32 font)
+{
+	const mapped_file& file = t.file;
+	const u8 *d = file.data;
+
+	u32 gpos_size = 0;
+	u32 gpos = find_table(file, font, TTF_TAG('G', 'P', 'O', 'S'), 10, &gpos_size);
+	if (gpos && read_u16(d + gpos) == 1) {
+		u32 end = gpos + gpos_size;
+		u32 features = gpos + read_u16(d + gpos + 6);
+		u32 lookups = gpos + read_u16(d + gpos + 8);
+
+		u32 lookup_count = 0;
+		if (features + 2 <= end && lookups + 2 <= end &&
+		    features + 2 + 6 * read_u16(d + features) <= end &&
+		    lookups + 2 + 2 * read_u16(d + lookups) <= end)
+			lookup_count = read_u16(d + lookups);
+
+		for (u32 i = 0; i < lookup_count; ++i) {
+			if (!is_kern_lookup(d, features, end, i))
+				continue;
+
+			u32 lookup = lookups + read_u16(d + lookups + 2 + 2 * i);
+			if (lookup + 6 > end)
+				continue;
+
+			u32 type = read_u16(d + lookup);
+			u32 subtables = read_u16(d + lookup + 4);
+			if (lookup + 6 + 2 * subtables > end)
+				continue;
+
+			for (u32 j = 0; j < subtables; ++j) {
+				u32 subtable = lookup + read_u16(d + lookup + 6 + 2 * j);
+
+				// an extension lookup points at subtables past 64 KB.
+				u32 subtable_type = type;
+				if (type == 9 && subtable + 8 <= end) {
+					subtable_type = read_u16(d + subtable + 2);
+					subtable += read_u32(d + subtable + 4);
+				}
+
+				if (subtable_type != 2 || (u64)subtable + 10 > end ||
+				    t.pair_subtable_count == TTF_MAX_PAIR_SUBTABLES)
+					continue;
+
+				ttf_pair_subtable& p = t.pair_subtables[t.pair_subtable_count++];
+				p.offset = subtable;
+				p.lookup = (i32)i;
+			}
+		}
+
+		if (t.pair_subtable_count > 0)
+			return;
+	}
+
+	u32 kern_size = 0;
+	u32 kern = find_table(file, font, TTF_TAG('k', 'e', 'r', 'n'), 4, &kern_size);
+	if (!kern || read_u16(d + kern) != 0)
+		return;
+
+	u32 end = kern + kern_size;
+	u32 subtable = kern + 4;
+	for (u32 i = read_u16(d + kern + 2); i > 0 && subtable + 14 <= end; --i) {
+		u32 length = read_u16(d + subtable + 2);
+		u32 coverage = read_u16(d + subtable + 4);
+		u32 count = read_u16(d + subtable + 6);
+
+		// format 0, horizontal, kerning values rather than minimums, not
+		// cross stream.
+		if ((coverage & 0xFF07) == 0x0001 && subtable + 14 + 6 * count <= end) {
+			t.kern_pairs = subtable + 14;
+			t.kern_pair_count = count;
+			return;
+		}
+
+		if (length < 14)
+			return;
+		subtable += length;
+	}
+}
+
+// maps the font with the given index in a font file or collection. fails
+// for anything without glyf outlines, which the platform renders instead.
+internal bool
+load_truetype(ttf_font& t, const char *path, i32 index)
+{
+	if (!sys_map_file(path, &t.file))
+		return false;
+
+	const mapped_file& file = t.file;
+	const u8 *d = file.data;
+
+	u32 font = 0;
+	if (file.size >= 12 && read_u32(d) == TTF_TAG('t', 't', 'c', 'f')) {
+		u32 count = read_u32(d + 8);
+		if ((u32)index >= count || 12 + 4 * (u64)count > file.size)
+			font = ~0u;
+		else
+			font = read_u32(d + 12 + 4 * (u32)index);
+	}
+
+	u32 cmap_size = 0;
+	u32 head = find_table(file, font, TTF_TAG('h', 'e', 'a', 'd'), 54);
+	u32 hhea = find_table(file, font, TTF_TAG('h', 'h', 'e', 'a'), 36);
+	u32 maxp = find_table(file, font, TTF_TAG('m', 'a', 'x', 'p'), 6);
+	u32 cmap = find_table(file, font, TTF_TAG('c', 'm', 'a', 'p'), 4, &cmap_size);
+	u32 loca_size = 0;
+	u32 loca = find_table(file, font, TTF_TAG('l', 'o', 'c', 'a'), 0, &loca_size);
+	u32 hmtx_size = 0;
+	u32 hmtx = find_table(file, font, TTF_TAG('h', 'm', 't', 'x'), 4, &hmtx_size);
+	t.glyf = find_table(file, font, TTF_TAG('g', 'l', 'y', 'f'), 0, &t.glyf_size);
+
+	if (head && hhea && maxp && cmap && loca && hmtx && t.glyf) {
+		t.units_per_em = (i32)read_u16(d + head + 18);
+		t.long_offsets = read_i16(d + head + 50) != 0;
+		t.glyph_count = (i32)read_u16(d + maxp + 4);
+		t.ascender = read_i16(d + hhea + 4);
+		t.descender = read_i16(d + hhea + 6);
+		t.line_gap = read_i16(d + hhea + 8);
+		t.advance_max = (i32)read_u16(d + hhea + 10);
+		t.long_metrics = (i32)read_u16(d + hhea + 34);
+		t.loca = loca;
+		t.hmtx = hmtx;
+		t.cmap = find_cmap_subtable(file, cmap, cmap_size);
+
+		u64 loca_needed = (u64)(t.glyph_count + 1) * (t.long_offsets ? 4 : 2);
+		if (t.cmap && t.units_per_em > 0 && t.long_metrics > 0 &&
+		    loca_needed <= loca_size && 4 * (u64)t.long_metrics <= hmtx_size) {
+			find_kerning(t, font);
+			return true;
+		}
+	}
+
+	sys_unmap_file(&t.file);
+	return false;
+}
+
+internal u32
+glyph_index(const ttf_font& t, u32 codepoint)
+{
+	const u8 *table = t.file.data + t.cmap;
+
+	if (read_u16(table) == 12) {
+		u32 count = read_u32(table + 12);
+		const u8 *groups = table + 16;
+
+		// first group ending at or after the codepoint.
+		u32 lo = 0;
+		u32 hi = count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			if (read_u32(groups + 12 * mid + 4) < codepoint)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo == count)
+			return 0;
+
+		const u8 *group = groups + 12 * lo;
+		u32 start = read_u32(group);
+		return codepoint >= start ? read_u32(group + 8) + codepoint - start : 0;
+	}
+
+	if (codepoint > 0xFFFF)
+		return 0;
+
+	u32 segments = read_u16(table + 6) / 2;
+	const u8 *ends = table + 14;
+	const u8 *starts = ends + 2 * segments + 2;
+	const u8 *deltas = starts + 2 * segments;
+	const u8 *range_offsets = deltas + 2 * segments;
+
+	u32 lo = 0;
+	u32 hi = segments;
+	while (lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if (read_u16(ends + 2 * mid) < codepoint)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == segments || read_u16(starts + 2 * lo) > codepoint)
+		return 0;
+
+	u32 delta = read_u16(deltas + 2 * lo);
+	u32 range_offset = read_u16(range_offsets + 2 * lo);
+	if (range_offset == 0)
+		return (codepoint + delta) & 0xFFFF;
+
+	const u8 *at = range_offsets + 2 * lo + range_offset + 2 * (codepoint - read_u16(starts + 2 * lo));
+	if (at + 2 > t.file.data + t.file.size)
+		return 0;
+
+	u32 index = read_u16(at);
+	return index ? (index + delta) & 0xFFFF : 0;
+}
+
+internal i32
+glyph_advance(const ttf_font& t, u32 index)
+{
+	u32 i = min(index, (u32)t.long_metrics - 1);
+	return (i32)read_u16(t.file.data + t.hmtx + 4 * i);
+}
+
+// the glyph's outline in glyf, or 0 if it has none.
+internal const u8 *
+glyph_data(const ttf_font& t, u32 index, u32 *size)
+{
+	if (index >= (u32)t.glyph_count)
+		return 0;
+
+	const u8 *loca = t.file.data + t.loca;
+	u32 start, end;
+	if (t.long_offsets) {
+		start = read_u32(loca + 4 * index);
+		end = read_u32(loca + 4 * index + 4);
+	}
+	else {
+		start = 2 * read_u16(loca + 2 * index);
+		end = 2 * read_u16(loca + 2 * index + 2);
+	}
+
+	if (end <= start || end > t.glyf_size || end - start < 10)
+		return 0;
+
+	*size = end - start;
+	return t.file.data + t.glyf + start;
+}
+
+internal inline bool
+in_file(const ttf_font& t, u64 offset, u64 n)
+{
+	return offset + n <= t.file.size;
+}
+
+// position of a glyph in a coverage table, or -1 if it is not covered.
+internal i32
+coverage_index(const ttf_font& t, u32 coverage, u32 glyph)
+{
+	const u8 *d = t.file.data;
+	if (!in_file(t, coverage, 4))
+		return -1;
+
+	u32 format = read_u16(d + coverage);
+	u32 count = read_u16(d + coverage + 2);
+
+	if (format == 1 && in_file(t, coverage + 4, 2 * (u64)count)) {
+		const u8 *glyphs = d + coverage + 4;
+		u32 lo = 0;
+		u32 hi = count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			u32 g = read_u16(glyphs + 2 * mid);
+			if (g < glyph)
+				lo = mid + 1;
+			else if (g > glyph)
+				hi = mid;
+			else
+				return (i32)mid;
+		}
+	}
+	else if (format == 2 && in_file(t, coverage + 4, 6 * (u64)count)) {
+		// first range ending at or after the glyph.
+		const u8 *ranges = d + coverage + 4;
+		u32 lo = 0;
+		u32 hi = count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			if (read_u16(ranges + 6 * mid + 2) < glyph)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo < count && read_u16(ranges + 6 * lo) <= glyph)
+			return (i32)(read_u16(ranges + 6 * lo + 4) + glyph - read_u16(ranges + 6 * lo));
+	}
+
+	return -1;
+}
+
+// class of a glyph in a class definition table. glyphs it does not list
+// are in class 0.
+internal u32
+glyph_class(const ttf_font& t, u32 class_def, u32 glyph)
+{
+	const u8 *d = t.file.data;
+	if (!in_file(t, class_def, 6))
+		return 0;
+
+	u32 format = read_u16(d + class_def);
+
+	if (format == 1) {
+		u32 start = read_u16(d + class_def + 2);
+		u32 count = read_u16(d + class_def + 4);
+		if (glyph >= start && glyph - start < count && in_file(t, class_def + 6, 2 * (u64)count))
+			return read_u16(d + class_def + 6 + 2 * (glyph - start));
+	}
+	else if (format == 2) {
+		u32 count = read_u16(d + class_def + 2);
+		if (!in_file(t, class_def + 4, 6 * (u64)count))
+			return 0;
+
+		const u8 *ranges = d + class_def + 4;
+		u32 lo = 0;
+		u32 hi = count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			if (read_u16(ranges + 6 * mid + 2) < glyph)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo < count && read_u16(ranges + 6 * lo) <= glyph)
+			return read_u16(ranges + 6 * lo + 4);
+	}
+
+	return 0;
+}
+
+// a value record holds one i16 for each bit of its format.
+internal inline u32
+value_record_size(u32 format)
+{
+	u32 size = 0;
+	for (; format; format &= format - 1)
+		size += 2;
+	return size;
+}
+
+// the advance adjustment in a value record, which follows the x and y
+// placements when they are present.
+internal inline i32
+x_advance(const u8 *record, u32 format)
+{
+	if (!(format & 0x4))
+		return 0;
+	return read_i16(record + 2 * ((format & 1) + (format >> 1 & 1)));
+}
+
+// the advance adjustment of the first glyph of a pair from a pair
+// adjustment subtable. false if the subtable does not cover the pair.
+internal bool
+pair_adjustment(const ttf_font& t, u32 subtable, u32 left, u32 right, i32 *adjust)
+{
+	const u8 *d = t.file.data;
+	u32 format = read_u16(d + subtable);
+	i32 covered = coverage_index(t, subtable + read_u16(d + subtable + 2), left);
+	if (covered < 0)
+		return false;
+
+	u32 format1 = read_u16(d + subtable + 4);
+	u32 size1 = value_record_size(format1);
+	u32 size2 = value_record_size(read_u16(d + subtable + 6));
+
+	if (format == 1) {
+		if ((u32)covered >= read_u16(d + subtable + 8) || !in_file(t, subtable + 10, 2 * (u64)covered + 2))
+			return false;
+
+		u32 set = subtable + read_u16(d + subtable + 10 + 2 * covered);
+		if (!in_file(t, set, 2))
+			return false;
+
+		u32 count = read_u16(d + set);
+		u32 stride = 2 + size1 + size2;
+		if (!in_file(t, set + 2, (u64)count * stride))
+			return false;
+
+		const u8 *pairs = d + set + 2;
+		u32 lo = 0;
+		u32 hi = count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			u32 g = read_u16(pairs + stride * mid);
+			if (g < right)
+				lo = mid + 1;
+			else if (g > right)
+				hi = mid;
+			else {
+				*adjust = x_advance(pairs + stride * mid + 2, format1);
+				return true;
+			}
+		}
+	}
+	else if (format == 2 && in_file(t, subtable, 16)) {
+		u32 class1 = glyph_class(t, subtable + read_u16(d + subtable + 8), left);
+		u32 class2 = glyph_class(t, subtable + read_u16(d + subtable + 10), right);
+		u32 count1 = read_u16(d + subtable + 12);
+		u32 count2 = read_u16(d + subtable + 14);
+		if (class1 >= count1 || class2 >= count2)
+			return false;
+
+		u64 record = subtable + 16 + ((u64)class1 * count2 + class2) * (size1 + size2);
+		if (!in_file(t, record, size1))
+			return false;
+
+		*adjust = x_advance(d + record, format1);
+		return true;
+	}
+
+	return false;
+}
+
+// kerning between two glyphs in font units. within a lookup the first
+// subtable covering the pair applies; the lookups add up.
+internal i32
+kern_pair(const ttf_font& t, u32 left, u32 right)
+{
+	i32 result = 0;
+
+	i32 matched = -1;
+	for (i32 i = 0; i < t.pair_subtable_count; ++i) {
+		const ttf_pair_subtable& p = t.pair_subtables[i];
+		i32 adjust = 0;
+		if (p.lookup != matched && pair_adjustment(t, p.offset, left, right, &adjust)) {
+			result += adjust;
+			matched = p.lookup;
+		}
+	}
+
+	if (t.kern_pair_count > 0) {
+		const u8 *pairs = t.file.data + t.kern_pairs;
+		u32 key = left << 16 | right;
+
+		u32 lo = 0;
+		u32 hi = t.kern_pair_count;
+		while (lo < hi) {
+			u32 mid = (lo + hi) / 2;
+			u32 k = read_u32(pairs + 6 * mid);
+			if (k < key)
+				lo = mid + 1;
+			else if (k > key)
+				hi = mid;
+			else
+				return read_i16(pairs + 6 * mid + 4);
+		}
+	}
+
+	return result;
+}
+
+internal inline vec2
+apply(const ttf_transform& m, f32 x, f32 y)
+{
+	return { m.xx * x + m.yx * y + m.dx, m.xy * x + m.yy * y + m.dy };
+}
+
+internal inline void
+add_line(glyph_outline& o, vec2 p0, vec2 p1)
+{
+	// horizontal lines cover no area.
+	if (p0.y == p1.y)
+		return;
+
+	*allocate_n(o.lines, 1) = { p0.x, p0.y, p1.x, p1.y };
+	o.x0 = min(o.x0, min(p0.x, p1.x));
+	o.y0 = min(o.y0, min(p0.y, p1.y));
+	o.x1 = max(o.x1, max(p0.x, p1.x));
+	o.y1 = max(o.y1, max(p0.y, p1.y));
+}
+
+// flattens a quadratic bezier into lines that stay within about a tenth
+// of a pixel of the curve.
+internal void
+add_curve(glyph_outline& o, vec2 p0, vec2 c, vec2 p1)
+{
+	f32 ddx = p0.x - 2.f * c.x + p1.x;
+	f32 ddy = p0.y - 2.f * c.y + p1.y;
+	i32 n = 1 + (i32)square_root(square_root(ddx * ddx + ddy * ddy) * 1.25f);
+
+	f32 step = 1.f / (f32)n;
+	vec2 from = p0;
+	for (i32 i = 1; i < n; ++i) {
+		f32 s = step * (f32)i;
+		f32 a = (1.f - s) * (1.f - s);
+		f32 b = 2.f * s * (1.f - s);
+		f32 e = s * s;
+		vec2 to = { a * p0.x + b * c.x + e * p1.x, a * p0.y + b * c.y + e * p1.y };
+		add_line(o, from, to);
+		from = to;
+	}
+	add_line(o, from, p1);
+}
+
+internal inline vec2
+midpoint(vec2 a, vec2 b)
+{
+	return { .5f * (a.x + b.x), .5f * (a.y + b.y) };
+}
+
+// adds the contours of a simple glyph. points off the curve are control
+// points of quadratic curves, and two in a row imply an on curve point
+// halfway between them.
+internal bool
+add_simple_glyph(glyph_outline& o, const u8 *g, u32 size, const ttf_transform& m)
+{
+	const u8 *end = g + size;
+	i32 contours = read_i16(g);
+	const u8 *end_points = g + 10;
+	if (contours == 0)
+		return true;
+	if (end_points + 2 * contours + 2 > end)
+		return false;
+
+	u32 point_count = read_u16(end_points + 2 * (contours - 1)) + 1;
+	const u8 *p = end_points + 2 * contours;
+	p += 2 + read_u16(p);
+
+	clear(o.points);
+	clear(o.on_curve);
+	vec2 *points = allocate_n(o.points, (i32)point_count);
+	u8 *flags = allocate_n(o.on_curve, (i32)point_count);
+
+	for (u32 i = 0; i < point_count;) {
+		if (p >= end)
+			return false;
+		u8 f = *p++;
+		u32 repeat = 1;
+		if (f & 8) {
+			if (p >= end)
+				return false;
+			repeat += *p++;
+		}
+		for (; repeat > 0 && i < point_count; --repeat)
+			flags[i++] = f;
+	}
+
+	// x coordinates, then y coordinates, as deltas that are either a byte
+	// with a sign in the flags, a 16 bit value, or 0.
+	for (i32 axis = 0; axis < 2; ++axis) {
+		u8 short_bit = axis ? 4 : 2;
+		u8 same_bit = axis ? 32 : 16;
+		i32 v = 0;
+
+		for (u32 i = 0; i < point_count; ++i) {
+			u8 f = flags[i];
+			if (f & short_bit) {
+				if (p + 1 > end)
+					return false;
+				v += (f & same_bit) ? *p : -(i32)*p;
+				p += 1;
+			}
+			else if (!(f & same_bit)) {
+				if (p + 2 > end)
+					return false;
+				v += read_i16(p);
+				p += 2;
+			}
+
+			(axis ? points[i].y : points[i].x) = (f32)v;
+		}
+	}
+
+	for (u32 i = 0; i < point_count; ++i) {
+		points[i] = apply(m, points[i].x, points[i].y);
+		flags[i] &= 1;
+	}
+
+	u32 first = 0;
+	for (i32 c = 0; c < contours; ++c) {
+		u32 last = read_u16(end_points + 2 * c);
+		if (last < first || last >= point_count)
+			return false;
+
+		// start on the curve: the first point, the last one, or halfway
+		// between them.
+		vec2 start;
+		u32 i = first;
+		u32 e = last;
+		if (flags[first]) {
+			start = points[first];
+			++i;
+		}
+		else if (flags[last]) {
+			start = points[last];
+			--e;
+		}
+		else {
+			start = midpoint(points[last], points[first]);
+		}
+
+		vec2 pen = start;
+		vec2 control = {};
+		bool curve = false;
+
+		for (; i <= e; ++i) {
+			if (flags[i]) {
+				if (curve)
+					add_curve(o, pen, control, points[i]);
+				else
+					add_line(o, pen, points[i]);
+				pen = points[i];
+				curve = false;
+			}
+			else {
+				if (curve) {
+					vec2 mid = midpoint(control, points[i]);
+					add_curve(o, pen, control, mid);
+					pen = mid;
+				}
+				control = points[i];
+				curve = true;
+			}
+		}
+
+		if (curve)
+			add_curve(o, pen, control, start);
+		else
+			add_line(o, pen, start);
+
+		first = last + 1;
+	}
+
+	return true;
+}
+
+internal bool
+add_glyph_outline(const ttf_font& t, glyph_outline& o, u32 index, const ttf_transform& m, i32 depth)
+{
+	u32 size = 0;
+	const u8 *g = glyph_data(t, index, &size);
+	if (!g)
+		return true;
+
+	if (read_i16(g) >= 0)
+		return add_simple_glyph(o, g, size, m);
+
+	if (depth >= TTF_MAX_DEPTH)
+		return false;
+
+	// a composite glyph places other glyphs with a transform each.
+	const u8 *end = g + size;
+	const u8 *p = g + 10;
+	u32 flags;
+	do {
+		if (p + 4 > end)
+			return false;
+		flags = read_u16(p);
+		u32 component = read_u16(p + 2);
+		p += 4;
+
+		f32 e, f;
+		if (flags & 0x1) {
+			if (p + 4 > end)
+				return false;
+			e = (f32)read_i16(p);
+			f = (f32)read_i16(p + 2);
+			p += 4;
+		}
+		else {
+			if (p + 2 > end)
+				return false;
+			e = (f32)(i8)p[0];
+			f = (f32)(i8)p[1];
+			p += 2;
+		}
+
+		// anchoring to points instead of offsets is not supported.
+		if (!(flags & 0x2))
+			e = f = 0;
+
+		f32 a = 1, b = 0, c = 0, d = 1;
+		const f32 f2dot14 = 1.f / 16384.f;
+		if (flags & 0x8) {
+			if (p + 2 > end)
+				return false;
+			a = d = (f32)read_i16(p) * f2dot14;
+			p += 2;
+		}
+		else if (flags & 0x40) {
+			if (p + 4 > end)
+				return false;
+			a = (f32)read_i16(p) * f2dot14;
+			d = (f32)read_i16(p + 2) * f2dot14;
+			p += 4;
+		}
+		else if (flags & 0x80) {
+			if (p + 8 > end)
+				return false;
+			a = (f32)read_i16(p) * f2dot14;
+			b = (f32)read_i16(p + 2) * f2dot14;
+			c = (f32)read_i16(p + 4) * f2dot14;
+			d = (f32)read_i16(p + 6) * f2dot14;
+			p += 8;
+		}
+
+		ttf_transform n;
+		n.xx = m.xx * a + m.yx * b;
+		n.xy = m.xy * a + m.yy * b;
+		n.yx = m.xx * c + m.yx * d;
+		n.yy = m.xy * c + m.yy * d;
+		n.dx = m.xx * e + m.yx * f + m.dx;
+		n.dy = m.xy * e + m.yy * f + m.dy;
+
+		if (!add_glyph_outline(t, o, component, n, depth + 1))
+			return false;
+	} while (flags & 0x20);
+
+	return true;
+}
+
+// the platforms size fonts for this many dots per inch too.
+#define FONT_DPI	96
+
+internal inline f32
+truetype_scale(const ttf_font& t, i32 pixel_height)
+{
+	return (f32)(pixel_height * FONT_DPI / 72) / (f32)t.units_per_em;
+}
+
+// kerning between two glyphs in whole pixels, rounded like the advances.
+// fonts the platform renders have none.
+internal inline i32
+kerning(const struct font *font, u32 left, u32 right)
+{
+	if (!font->ttf || !left || !right)
+		return 0;
+
+	const ttf_font& t = *font->ttf;
+	return floor_i32((f32)kern_pair(t, left, right) * truetype_scale(t, font->pixel_height) + .5f);
+}
+
+// flattens the outline of a codepoint into o and returns its advance in
+// whole pixels. a malformed outline comes back empty.
+internal i32
+outline_codepoint(const struct font *font, u32 codepoint, glyph_outline& o)
+{
+	const ttf_font& t = *font->ttf;
+	f32 scale = truetype_scale(t, font->pixel_height);
+
+	clear(o.lines);
+	o.x0 = o.y0 = 3.4e38f;
+	o.x1 = o.y1 = -3.4e38f;
+
+	u32 index = glyph_index(t, codepoint);
+	ttf_transform m = { scale, 0, 0, scale, 0, 0 };
+	if (!add_glyph_outline(t, o, index, m, 0))
+		clear(o.lines);
+
+	return floor_i32((f32)glyph_advance(t, index) * scale + .5f);
+}
+
+// the pixels an outline touches in the frame the platform renders glyphs
+// in, where the pen sits at (default_x, default_y + descent).
+internal rect2i
+outline_ink(const struct font *font, const glyph_outline& o)
+{
+	i32 x = font->default_x;
+	i32 y = font->default_y + font->descent;
+	return { x + floor_i32(o.x0), y + floor_i32(o.y0), x + floor_i32(o.x1 - 1e-4f), y + floor_i32(o.y1 - 1e-4f) };
+}
+
+// adds the signed area a line covers to every pixel in a grid whose rows
+// are stride apart. the area right of the line in a row is added to the
+// pixel after the line, so a running sum along the row completes it.
+internal void
+accumulate_line(f32 *area, i32 stride, i32 h, outline_line l)
+{
+	f32 dir = 1.f;
+	if (l.y0 > l.y1) {
+		l = { l.x1, l.y1, l.x0, l.y0 };
+		dir = -1.f;
+	}
+
+	f32 dxdy = (l.x1 - l.x0) / (l.y1 - l.y0);
+	f32 x = l.x0;
+	i32 y_end = min(h, floor_i32(l.y1) + (l.y1 > (f32)floor_i32(l.y1)));
+
+	for (i32 y = max(floor_i32(l.y0), 0); y < y_end; ++y) {
+		f32 *row = area + y * stride;
+		f32 dy = min((f32)(y + 1), l.y1) - max((f32)y, l.y0);
+		f32 x_next = x + dxdy * dy;
+		f32 d = dy * dir;
+
+		f32 x0 = min(x, x_next);
+		f32 x1 = max(x, x_next);
+		i32 x0i = floor_i32(x0);
+		i32 x1i = floor_i32(x1);
+		if ((f32)x1i < x1)
+			++x1i;
+
+		if (x1i <= x0i + 1) {
+			// within one pixel: split by the mean x.
+			f32 xm = .5f * (x + x_next) - (f32)x0i;
+			row[x0i] += d - d * xm;
+			row[x0i + 1] += d * xm;
+		}
+		else {
+			f32 s = 1.f / (x1 - x0);
+			f32 x0f = x0 - (f32)x0i;
+			f32 a0 = .5f * s * (1.f - x0f) * (1.f - x0f);
+			f32 x1f = x1 - (f32)x1i + 1.f;
+			f32 am = .5f * s * x1f * x1f;
+
+			row[x0i] += d * a0;
+			if (x1i == x0i + 2) {
+				row[x0i + 1] += d * (1.f - a0 - am);
+			}
+			else {
+				f32 a1 = s * (1.5f - x0f);
+				row[x0i + 1] += d * (a1 - a0);
+				for (i32 xi = x0i + 2; xi < x1i - 1; ++xi)
+					row[xi] += d * s;
+				f32 a2 = a1 + (f32)(x1i - x0i - 3) * s;
+				row[x1i - 1] += d * (1.f - a2 - am);
+			}
+			row[x1i] += d * am;
+		}
+
+		x = x_next;
+	}
+}
+
+// running sums of the area along each row, clamped to coverage. the area
+// is cleared for the next glyph.
+internal void
+resolve_coverage(f32 *area, i32 stride, i32 w, i32 h, u8 *dst, i32 dst_stride)
+{
+	for (i32 y = 0; y < h; ++y) {
+		f32 *row = area + y * stride;
+		u8 *out = dst + y * dst_stride;
+		i32 x = 0;
+
+#if SIMD_SSE2
+		// prefix sums of 4 at a time, carrying the last one along.
+		__m128 carry = _mm_setzero_ps();
+		__m128 sign = _mm_set1_ps(-0.f);
+		__m128 one = _mm_set1_ps(1.f);
+		__m128 scale = _mm_set1_ps(255.f);
+		__m128 half = _mm_set1_ps(.5f);
+		for (; x + 4 <= w; x += 4) {
+			__m128 v = _mm_loadu_ps(row + x);
+			v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+			v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+			v = _mm_add_ps(v, carry);
+			carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+			_mm_storeu_ps(row + x, _mm_setzero_ps());
+
+			__m128 c = _mm_min_ps(_mm_andnot_ps(sign, v), one);
+			__m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), half));
+			i = _mm_packs_epi32(i, i);
+			i = _mm_packus_epi16(i, i);
+			u32 packed = (u32)_mm_cvtsi128_si32(i);
+			copy_bytes(out + x, &packed, 4);
+		}
+		f32 sum = _mm_cvtss_f32(carry);
+#else
+		f32 sum = 0;
+#endif
+
+		for (; x < w; ++x) {
+			sum += row[x];
+			row[x] = 0;
+			f32 c = min(sum < 0 ? -sum : sum, 1.f);
+			out[x] = (u8)(c * 255.f + .5f);
+		}
+
+		// the pixel after the last one, and any other spill past w.
+		for (; x < stride; ++x)
+			row[x] = 0;
+	}
+}
+
+// rasterizes an outline over the pixels of ink, relative to the pen like
+// outline_ink returns them, into w * h bytes of coverage rows stride
+// apart.
+internal void
+rasterize_outline(const struct font *font, glyph_outline& o, rect2i ink, u8 *dst, i32 dst_stride)
+{
+	profile_function();
+
+	i32 w = ink.x1 - ink.x0 + 1;
+	i32 h = ink.y1 - ink.y0 + 1;
+	i32 stride = w + 2;
+
+	// the area is kept cleared between glyphs.
+	i32 needed = stride * h;
+	if (o.area.limit < needed) {
+		i32 old = o.area.limit;
+		reserve(o.area, needed);
+		fill_n(needed - old, o.area.data + old, 0.f);
+	}
+
+	f32 x = (f32)(ink.x0 - font->default_x);
+	f32 y = (f32)(ink.y0 - font->default_y - font->descent);
+
+	for (outline_line l : o.lines) {
+		outline_line r = { l.x0 - x, l.y0 - y, l.x1 - x, l.y1 - y };
+		accumulate_line(o.area.data, stride, h, r);
+	}
+
+	resolve_coverage(o.area.data, stride, w, h, dst, dst_stride);
+}
+
+////////
+//
+// glyph atlas.
+//
+// glyphs are packed into square pages with a skyline packer. when nothing
+// fits, the last page grows by reallocation up to max_size, then a new page
+// is added up to max_pages. once that budget is used up, glyphs that were
+// not drawn for evict_age frames are evicted and the survivors are repacked.
+// evicted glyphs keep their metrics and are rasterized again on next use.
+
+internal void flush_batch(struct app_state *state);
+internal void invalidate_layouts(layout_cache& c);
+
+internal inline struct glyph *
+find_glyph(struct font *font, u32 codepoint)
+{
+	if (codepoint < 256) {
+		i32 i = font->latin1[codepoint];
+		return i ? font->glyphs.data + i - 1 : 0;
+	}
+
+	i32 *i = find(font->glyph_map, codepoint);
+	return i ? font->glyphs.data + *i : 0;
+}
+
+internal inline void
+mark_dirty(atlas_page& page, rect2i r)
+{
+	rect2i& d = page.dirty;
+
+	if (d.x0 >= d.x1) {
+		d = r;
+	}
+	else {
+		d.x0 = min(d.x0, r.x0);
+		d.y0 = min(d.y0, r.y0);
+		d.x1 = max(d.x1, r.x1);
+		d.y1 = max(d.y1, r.y1);
+	}
+}
+
+internal void
+reset_skyline(atlas_page& page, i32 x, i32 width)
+{
+	skyline_node *n = allocate_n(page.skyline, 1);
+	n->x = x;
+	n->y = 0;
+	n->width = width;
+}
+
+// finds the position where a w x h rectangle ends up lowest, preferring
+// narrower spans on ties.
+internal bool
+skyline_find(atlas_page& page, i32 w, i32 h, i32 *index, i32 *x, i32 *y)
+{
+	skyline_node *nodes = page.skyline.data;
+	i32 best_bottom = page.size + 1;
+	i32 best_width = page.size + 1;
+
+	for (i32 i = 0; i < page.skyline.count; ++i) {
+		if (nodes[i].x + w > page.size)
+			break;
+
+		i32 top = 0;
+		i32 remaining = w;
+		for (i32 j = i; remaining > 0; ++j) {
+			top = max(top, nodes[j].y);
+			remaining -= nodes[j].width;
+		}
+
+		i32 bottom = top + h;
+		if (bottom > page.size)
+			continue;
+
+		if (bottom < best_bottom || (bottom == best_bottom && nodes[i].width < best_width)) {
+			best_bottom = bottom;
+			best_width = nodes[i].width;
+			*index = i;
+			*x = nodes[i].x;
+			*y = top;
+		}
+	}
+
+	return best_bottom <= page.size;
+}
+
+internal void
+skyline_insert(atlas_page& page, i32 index, i32 x, i32 y, i32 w, i32 h)
+{
+	array<i32, skyline_node>& a = page.skyline;
+
+	allocate_n(a, 1);
+	for (i32 i = a.count - 1; i > index; --i)
+		a.data[i] = a.data[i - 1];
+	a.data[index] = { x, y + h, w };
+
+	// shrink or drop the nodes now covered by the new one.
+	i32 right = x + w;
+	i32 i = index + 1;
+	while (i < a.count && a.data[i].x < right) {
+		skyline_node& n = a.data[i];
+		i32 shrink = right - n.x;
+		if (shrink < n.width) {
+			n.x += shrink;
+			n.width -= shrink;
+			break;
+		}
+
+		copy_n(a.count - i - 1, a.data + i, a.data + i + 1);
+		--a.count;
+	}
+
+	// merge neighbours of the same height.
+	i = 0;
+	while (i + 1 < a.count) {
+		if (a.data[i].y == a.data[i + 1].y) {
+			a.data[i].width += a.data[i + 1].width;
+			copy_n(a.count - i - 2, a.data + i + 1, a.data + i + 2);
+			--a.count;
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+internal void
+create_page_texture(glyph_atlas& atlas, atlas_page& page)
+{
+	if (!page.texture)
+		glGenTextures(1, &page.texture);
+
+	glBindTexture(GL_TEXTURE_2D, page.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, atlas.filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, atlas.filter);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, page.size, page.size, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	page.dirty = { 0, 0, page.size, page.size };
+}
+
+internal void
+add_page(glyph_atlas& atlas)
+{
+	atlas_page& page = atlas.pages[atlas.page_count++];
+
+	page.size = atlas.min_size;
+	page.bits = allocate<u8>((size_t)page.size * (size_t)page.size, ALLOCATE_ZERO);
+	page.used = 0;
+	clear(page.skyline);
+	reset_skyline(page, 0, page.size);
+
+	create_page_texture(atlas, page);
+}
+
+// doubles the size of a page. glyph coordinates are in texels so they stay
+// valid; only the texture has to be respecified.
+internal void
+grow_page(glyph_atlas& atlas, atlas_page& page)
+{
+	i32 size = min(page.size * 2, atlas.max_size);
+	u8 *bits = allocate<u8>((size_t)size * (size_t)size, ALLOCATE_ZERO);
+
+	u8 *src = page.bits;
+	u8 *dst = bits;
+	for (i32 y = 0; y < page.size; ++y) {
+		copy_n(page.size, dst, src);
+		src += page.size;
+		dst += size;
+	}
+	sys_deallocate(page.bits, (size_t)page.size * (size_t)page.size, alignof(u8));
+
+	reset_skyline(page, page.size, size - page.size);
+	page.size = size;
+	page.bits = bits;
+
+	create_page_texture(atlas, page);
+	++atlas.growths;
+}
+
+internal bool
+pack_rect(glyph_atlas& atlas, i32 w, i32 h, i32 *page, i32 *x, i32 *y)
+{
+	for (i32 i = 0; i < atlas.page_count; ++i) {
+		atlas_page& p = atlas.pages[i];
+
+		i32 index = 0;
+		if (skyline_find(p, w, h, &index, x, y)) {
+			skyline_insert(p, index, *x, *y, w, h);
+			p.used += (i64)w * h;
+			*page = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+internal inline bool
+is_packed(const glyph& g)
+{
+	return g.page >= 0 && g.x1 > g.x0;
+}
+
+internal inline glyph_atlas&
+font_atlas(struct app_state *state, struct font *font)
+{
+	return font->sdf_spread ? state->sdf_atlas : state->atlas;
+}
+
+// reserves a 2x2 white block in the top left corner of the first page.
+// solid rectangles, and the boxes of pending glyphs, sample its center so
+// they can share a program with glyphs. white is as far inside as a
+// distance field gets, so it works for both kinds of atlas.
+internal void
+reserve_white_block(glyph_atlas& atlas)
+{
+	i32 page, x, y;
+	pack_rect(atlas, 2, 2, &page, &x, &y);
+	fill_n(2, atlas.pages[0].bits, (u8)0xFF);
+	fill_n(2, atlas.pages[0].bits + atlas.pages[0].size, (u8)0xFF);
+}
+
+// evicts every packed glyph that was not drawn during the last max_age
+// frames and packs the remaining ones again from scratch. anything already
+// recorded in the batch refers to the old layout, so the batch is flushed
+// first.
+internal void
+repack_atlas(struct app_state *state, glyph_atlas& atlas, u32 max_age)
+{
+	profile_function();
+
+	flush_batch(state);
+	invalidate_layouts(state->layouts);
+
+	// the survivors and a copy of the old pages only live until the end.
+	arena& temp = state->frame_arena;
+	size_t mark = temp.used;
+
+	array<i32, glyph *> survivors = {};
+	survivors.from = &temp.base;
+	i32 tallest = 0;
+
+	for (font *f : state->fonts) {
+		if (&font_atlas(state, f) != &atlas)
+			continue;
+
+		for (glyph& g : f->glyphs) {
+			if (!is_packed(g))
+				continue;
+
+			if (state->frame - g.last_used > max_age) {
+				g.page = GLYPH_UNLOADED;
+				++atlas.evictions;
+			}
+			else {
+				*allocate_n(survivors, 1) = &g;
+				tallest = max(tallest, g.y1 - g.y0);
+			}
+		}
+	}
+
+	u8 *old_bits[ATLAS_MAX_PAGES];
+	for (i32 i = 0; i < atlas.page_count; ++i) {
+		atlas_page& page = atlas.pages[i];
+
+		size_t size = (size_t)page.size * (size_t)page.size;
+		old_bits[i] = allocate<u8>(&temp.base, size);
+		copy_n(size, old_bits[i], page.bits);
+		fill_n(size, page.bits, (u8)0);
+		page.used = 0;
+		page.dirty = { 0, 0, page.size, page.size };
+		clear(page.skyline);
+		reset_skyline(page, 0, page.size);
+	}
+
+	reserve_white_block(atlas);
+
+	// tallest first packs a skyline much tighter than arbitrary order.
+	for (i32 h = tallest; h > 0; --h) {
+		for (glyph *g : survivors) {
+			if (g->y1 - g->y0 != h)
+				continue;
+
+			i32 w = g->x1 - g->x0;
+			i32 page, x, y;
+			if (!pack_rect(atlas, w, h, &page, &x, &y)) {
+				g->page = GLYPH_UNLOADED;
+				++atlas.evictions;
+				continue;
+			}
+
+			atlas_page& from = atlas.pages[g->page];
+			atlas_page& to = atlas.pages[page];
+
+			u8 *src = old_bits[g->page] + g->y0 * from.size + g->x0;
+			u8 *dst = to.bits + y * to.size + x;
+			for (i32 row = 0; row < h; ++row) {
+				copy_n(w, dst, src);
+				src += from.size;
+				dst += to.size;
+			}
+
+			g->page = page;
+			g->x0 = x;
+			g->y0 = y;
+			g->x1 = x + w;
+			g->y1 = y + h;
+		}
+	}
+
+	reset_arena(temp, mark);
+
+	++atlas.repacks;
+}
+
+internal bool
+allocate_atlas_rect(struct app_state *state, glyph_atlas& atlas, i32 w, i32 h, i32 *page, i32 *x, i32 *y)
+{
+	if (pack_rect(atlas, w, h, page, x, y))
+		return true;
+
+	// only the last page can be below the maximum size, including one
+	// that was just added.
+	for (;;) {
+		atlas_page& last = atlas.pages[atlas.page_count - 1];
+		while (last.size < atlas.max_size) {
+			grow_page(atlas, last);
+			if (pack_rect(atlas, w, h, page, x, y))
+				return true;
+		}
+
+		if (atlas.page_count == atlas.max_pages)
+			break;
+
+		add_page(atlas);
+		if (pack_rect(atlas, w, h, page, x, y))
+			return true;
+	}
+
+	repack_atlas(state, atlas, atlas.evict_age);
+	if (pack_rect(atlas, w, h, page, x, y))
+		return true;
+
+	// keep only what the current frame uses.
+	repack_atlas(state, atlas, 0);
+	return pack_rect(atlas, w, h, page, x, y);
+}
+
+// uploads the dirty part of every page. glyphs added during a frame are
+// usually packed next to each other, so a single bounding rectangle per
+// page covers them without much waste.
+internal void
+upload_atlas(struct app_state *state, glyph_atlas& atlas)
+{
+	profile_function();
+
+	for (i32 i = 0; i < atlas.page_count; ++i) {
+		atlas_page& page = atlas.pages[i];
+
+		rect2i d = page.dirty;
+		if (d.x0 >= d.x1)
+			continue;
+
+		i32 w = d.x1 - d.x0;
+		i32 h = d.y1 - d.y0;
+		u8 *src = page.bits + d.y0 * page.size + d.x0;
+
+		glBindTexture(GL_TEXTURE_2D, page.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		if (atlas.pbo) {
+			ptrdiff_t size = (ptrdiff_t)w * h;
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas.pbo);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW);
+			u8 *dst = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			assert(dst);
+
+			for (i32 y = 0; y < h; ++y) {
+				copy_n(w, dst, src);
+				dst += w;
+				src += page.size;
+			}
+
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, d.x0, d.y0, w, h, GL_RED, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		else {
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, page.size);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, d.x0, d.y0, w, h, GL_RED, GL_UNSIGNED_BYTE, src);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		state->batch.stats.atlas_upload_bytes += (i64)w * h;
+		state->batch.stats.upload_bytes += (i64)w * h;
+		page.dirty = {};
+	}
+}
+
+// allocates the atlas rectangle of a glyph and marks it for upload. ink is
+// where the glyph sits in the bitmap it is rendered to. returns where the
+// first row of the glyph goes, with rows *stride bytes apart, or 0 if the
+// atlas is full. a glyph that does not fit is marked GLYPH_TOO_LARGE, as
+// trying again would repack the atlas twice every frame it is drawn.
+internal u8 *
+allocate_glyph(struct app_state *state, struct font *font, struct glyph *g, rect2i ink, i32 *stride)
+{
+	i32 w = ink.x1 - ink.x0 + 1;
+	i32 h = ink.y1 - ink.y0 + 1;
+
+	glyph_atlas& atlas = font_atlas(state, font);
+
+	// nothing bigger than an empty page is worth repacking for.
+	i32 page, x, y;
+	if (w > atlas.max_size || h > atlas.max_size ||
+	    !allocate_atlas_rect(state, atlas, w, h, &page, &x, &y)) {
+		g->page = GLYPH_TOO_LARGE;
+		++atlas.too_large;
+		return 0;
+	}
+
+	atlas_page& to = atlas.pages[page];
+
+	g->page = page;
+	g->dx = ink.x0 - font->default_x;
+	g->dy = ink.y0 - font->default_y;
+	g->x0 = x;
+	g->y0 = y;
+	g->x1 = x + w;
+	g->y1 = y + h;
+
+	mark_dirty(to, { g->x0, g->y0, g->x1, g->y1 });
+
+	*stride = to.size;
+	return to.bits + y * to.size + x;
+}
+
+// copies coverage into a freshly allocated atlas rectangle.
+internal void
+place_glyph(struct app_state *state, struct font *font, struct glyph *g, rect2i ink, const u8 *coverage)
+{
+	i32 stride;
+	u8 *dst = allocate_glyph(state, font, g, ink, &stride);
+	if (!dst)
+		return;
+
+	i32 w = ink.x1 - ink.x0 + 1;
+	i32 h = ink.y1 - ink.y0 + 1;
+	for (i32 row = 0; row < h; ++row) {
+		copy_n(w, dst, coverage);
+		coverage += w;
+		dst += stride;
+	}
+}
+
+internal inline void
+clear_glyph(struct glyph *g)
+{
+	g->page = 0;
+	g->dx = 0;
+	g->dy = 0;
+	g->x0 = 0;
+	g->y0 = 0;
+	g->x1 = 0;
+	g->y1 = 0;
+}
+
+// copies the inked part of a rendered bitmap into w * h bytes of coverage.
+internal void
+extract_ink(u8 *dst, const struct font *font, rect2i ink)
+{
+	i32 w = ink.x1 - ink.x0 + 1;
+	const u32 *src = font->bits + ink.y0 * font->bitmap_width + ink.x0;
+
+	for (i32 y = ink.y0; y <= ink.y1; ++y) {
+		extract_coverage(dst, src, w);
+		src += font->bitmap_width;
+		dst += w;
+	}
+}
+
+// the maximum spread of a distance field, in texels.
+#define SDF_MAX_SPREAD	16
+
+// turns w * h bytes of coverage into a signed distance field padded by
+// spread texels on every side, (w + 2 * spread) * (h + 2 * spread) bytes.
+// a texel stores 128 plus 127 / spread per texel of distance to the
+// outline, positive inside, clamped at spread. the outline crosses a
+// partially covered pixel at a distance from its center given by its
+// coverage, so anti-aliased edges keep their position within the pixel.
+// searching the spread around every texel is quadratic in the spread,
+// but it runs once per glyph.
+internal void
+make_distance_field(u8 *dst, const u8 *coverage, i32 w, i32 h, i32 spread)
+{
+	profile_function();
+
+	assert(spread > 0 && spread <= SDF_MAX_SPREAD);
+
+	// distance between pixel centers by offset.
+	const i32 side = 2 * SDF_MAX_SPREAD + 1;
+	f32 distance[side * side];
+	for (i32 y = -spread; y <= spread; ++y)
+		for (i32 x = -spread; x <= spread; ++x)
+			distance[(y + SDF_MAX_SPREAD) * side + x + SDF_MAX_SPREAD] = square_root((f32)(x * x + y * y));
+
+	// how far the outline is from the center of a pixel with coverage c.
+	f32 edge[256];
+	for (i32 c = 0; c < 256; ++c)
+		edge[c] = c < 128 ? .5f - (f32)c / 255.f : (f32)c / 255.f - .5f;
+
+	f32 unit = 127.f / (f32)spread;
+
+	for (i32 ty = -spread; ty < h + spread; ++ty) {
+		for (i32 tx = -spread; tx < w + spread; ++tx) {
+			bool in_ink = tx >= 0 && tx < w && ty >= 0 && ty < h;
+			u32 c = in_ink ? coverage[ty * w + tx] : 0;
+			bool inside = c >= 128;
+
+			f32 best = (f32)spread;
+			if (c > 0 && c < 255)
+				best = edge[c];
+
+			// outside texels only find the outline in the ink.
+			i32 y0 = inside ? ty - spread : max(ty - spread, 0);
+			i32 y1 = inside ? ty + spread : min(ty + spread, h - 1);
+			i32 x0 = inside ? tx - spread : max(tx - spread, 0);
+			i32 x1 = inside ? tx + spread : min(tx + spread, w - 1);
+
+			for (i32 y = y0; y <= y1; ++y) {
+				const f32 *row = distance + (y - ty + SDF_MAX_SPREAD) * side + SDF_MAX_SPREAD - tx;
+				for (i32 x = x0; x <= x1; ++x) {
+					u32 q = x >= 0 && x < w && y >= 0 && y < h ? coverage[y * w + x] : 0;
+					if ((q >= 128) == inside)
+						continue;
+
+					f32 d = row[x] - edge[q];
+					if (d < best)
+						best = d;
+				}
+			}
+
+			f32 v = 128.f + (inside ? best : -best) * unit;
+			*dst++ = (u8)(v < 0.f ? 0.f : v > 255.f ? 255.f : v + .5f);
+		}
+	}
+}
+
+// replaces the coverage of a glyph of a distance field font with its
+// distance field, both allocated from the same place, and grows ink by the
+// padding of the field.
+internal u8 *
+convert_to_field(allocator *from, const struct font *font, rect2i *ink, u8 *coverage)
+{
+	i32 w = ink->x1 - ink->x0 + 1;
+	i32 h = ink->y1 - ink->y0 + 1;
+	i32 s = font->sdf_spread;
+
+	u8 *field = allocate<u8>(from, (size_t)((w + 2 * s) * (h + 2 * s)));
+	make_distance_field(field, coverage, w, h, s);
+	deallocate(from, coverage, (size_t)(w * h));
+
+	*ink = { ink->x0 - s, ink->y0 - s, ink->x1 + s, ink->y1 + s };
+	return field;
+}
+
+// rasterizes a glyph on the render thread. coverage of a truetype font
+// goes straight into its atlas rectangle.
+internal void
+rasterize_glyph(struct app_state *state, struct font *font, struct glyph *g)
+{
+	profile_function();
+
+	glyph_outline& o = state->outline;
+	rect2i ink;
+	bool has_ink;
+
+	if (font->ttf) {
+		g->xadv = outline_codepoint(font, g->codepoint, o);
+		has_ink = !is_empty(o.lines);
+		if (has_ink)
+			ink = outline_ink(font, o);
+	}
+	else {
+		g->xadv = sys_render_glyph(font, g->codepoint);
+		has_ink = ink_bounds(font->bits, font->bitmap_width, font->bitmap_height, &ink);
+	}
+
+	++font_atlas(state, font).rasterized;
+	clear_glyph(g);
+
+	if (!has_ink)
+		return;
+
+	if (font->ttf && !font->sdf_spread) {
+		i32 stride;
+		if (u8 *dst = allocate_glyph(state, font, g, ink, &stride))
+			rasterize_outline(font, o, ink, dst, stride);
+		return;
+	}
+
+	arena& temp = state->frame_arena;
+	size_t mark = temp.used;
+	i32 w = ink.x1 - ink.x0 + 1;
+	u8 *coverage = allocate<u8>(&temp.base, (size_t)(w * (ink.y1 - ink.y0 + 1)));
+
+	if (font->ttf)
+		rasterize_outline(font, o, ink, coverage, w);
+	else
+		extract_ink(coverage, font, ink);
+
+	if (font->sdf_spread)
+		coverage = convert_to_field(&temp.base, font, &ink, coverage);
+	place_glyph(state, font, g, ink, coverage);
+
+	reset_arena(temp, mark);
+}
+
+// runs on a worker thread. truetype fonts are shared by every thread, each
+// with an outline of its own to rasterize with. platform fonts render into
+// a bitmap that is not shared safely, so every worker creates its own
+// instance.
+internal void
+rasterize_glyph_job(i32 worker, void *data)
+{
+	profile_function();
+
+	glyph_result *r = (glyph_result *)data;
+
+	while (r) {
+		// r belongs to the render thread as soon as it is pushed.
+		glyph_result *next = r->next;
+		glyph_workers& workers = *r->workers;
+
+		r->coverage = 0;
+
+		if (r->font->ttf) {
+			glyph_outline& o = workers.outlines[worker];
+			r->xadv = outline_codepoint(r->font, r->codepoint, o);
+			r->has_ink = !is_empty(o.lines);
+
+			if (r->has_ink) {
+				r->ink = outline_ink(r->font, o);
+				i32 w = r->ink.x1 - r->ink.x0 + 1;
+				r->coverage = allocate<u8>((size_t)(w * (r->ink.y1 - r->ink.y0 + 1)));
+				rasterize_outline(r->font, o, r->ink, r->coverage, w);
+			}
+		}
+		else {
+			font *&f = workers.fonts[r->font_index][worker];
+			if (!f) {
+				f = sys_create_font(r->font->name, r->font->pixel_height);
+				f->sdf_spread = r->font->sdf_spread;
+			}
+
+			r->xadv = sys_render_glyph(f, r->codepoint);
+			r->has_ink = ink_bounds(f->bits, f->bitmap_width, f->bitmap_height, &r->ink);
+
+			if (r->has_ink) {
+				i32 w = r->ink.x1 - r->ink.x0 + 1;
+				r->coverage = allocate<u8>((size_t)(w * (r->ink.y1 - r->ink.y0 + 1)));
+				extract_ink(r->coverage, f, r->ink);
+			}
+		}
+
+		if (r->coverage && r->font->sdf_spread)
+			r->coverage = convert_to_field(0, r->font, &r->ink, r->coverage);
+
+		bool ok = push(workers.results, r);
+		assert(ok);
+
+		r = next;
+	}
+}
+
+internal i32
+font_index(struct app_state *state, struct font *font)
+{
+	for (i32 i = 0; i < state->fonts.count; ++i)
+		if (state->fonts.data[i] == font)
+			return i;
+
+	assert(!"font not loaded");
+	return 0;
+}
+
+// creates a glyph_result requesting a glyph. the glyph is pending until
+// receive_glyphs gets the result back.
+internal glyph_result *
+request_glyph(struct app_state *state, struct font *font, struct glyph *g, glyph_result *next)
+{
+	glyph_workers& workers = state->workers;
+	assert(workers.in_flight < GLYPH_JOBS_MAX);
+
+	glyph_result *r = allocate<glyph_result>(&state->results.base, 1);
+	r->workers = &workers;
+	r->next = next;
+	r->font = font;
+	r->font_index = font_index(state, font);
+	r->codepoint = g->codepoint;
+
+	g->page = GLYPH_PENDING;
+	++workers.in_flight;
+
+	return r;
+}
+
+// packs the glyphs finished by the workers into the atlas.
+internal void
+receive_glyphs(struct app_state *state)
+{
+	profile_function();
+
+	glyph_workers& workers = state->workers;
+
+	glyph_result *r;
+	while (pop(workers.results, &r)) {
+		--workers.in_flight;
+
+		glyph *g = find_glyph(r->font, r->codepoint);
+		if (g && g->page == GLYPH_PENDING) {
+			g->xadv = r->xadv;
+			++font_atlas(state, r->font).rasterized;
+
+			clear_glyph(g);
+			if (r->has_ink)
+				place_glyph(state, r->font, g, r->ink, r->coverage);
+		}
+
+		if (r->coverage) {
+			size_t size = (size_t)((r->ink.x1 - r->ink.x0 + 1) * (r->ink.y1 - r->ink.y0 + 1));
+			sys_deallocate(r->coverage, size, alignof(u8));
+		}
+		deallocate(&state->results.base, r, 1);
+	}
+}
+
+internal struct glyph *
+add_glyph(struct font *font, u32 codepoint)
+{
+	if (codepoint < 256)
+		font->latin1[codepoint] = font->glyphs.count + 1;
+	else
+		insert(font->glyph_map, codepoint, font->glyphs.count);
+
+	glyph *g = allocate_n(font->glyphs, 1);
+	g->codepoint = codepoint;
+	g->xadv = 0;
+	g->last_used = 0;
+	g->id = font->ttf ? glyph_index(*font->ttf, codepoint) : 0;
+	clear_glyph(g);
+	g->page = GLYPH_UNLOADED;
+	return g;
+}
+
+// returns the glyph for a codepoint. glyphs that are not resident are
+// queued for the workers and stay pending for a frame or two; without
+// worker threads they are rasterized right away. the glyph is marked as
+// used in the current frame.
+internal struct glyph *
+render_glyph(struct app_state *state, struct font *font, u32 codepoint)
+{
+	// past unicode, and out of reach of the glyph map.
+	if (codepoint > 0x10FFFF)
+		codepoint = UTF8_REPLACEMENT;
+
+	glyph *g = find_glyph(font, codepoint);
+	if (!g)
+		g = add_glyph(font, codepoint);
+
+	g->last_used = state->frame;
+
+	if (g->page == GLYPH_UNLOADED) {
+		glyph_workers& workers = state->workers;
+		if (workers.count > 0 && workers.in_flight < GLYPH_JOBS_MAX)
+			sys_add_work(rasterize_glyph_job, request_glyph(state, font, g, 0));
+		else
+			rasterize_glyph(state, font, g);
+	}
+
+	return g;
+}
+
+// selects the pipeline state for the quads that follow. consecutive
+// calls with the same state extend the current command.
+internal void
+use_pipeline(render_batch& batch, u32 program, u32 texture, u32 blend)
+{
+	if (!is_empty(batch.commands)) {
+		draw_command *last = batch.commands.data + batch.commands.count - 1;
+		if (last->program == program && last->texture == texture && last->blend == blend)
+			return;
+		last->count = batch.count - last->first;
+	}
+
+	draw_command *c = allocate_n(batch.commands, 1);
+	c->program = program;
+	c->texture = texture;
+	c->blend = blend;
+	c->first = batch.count;
+	c->count = 0;
+}
+
+internal void
+map_region(render_batch& batch)
+{
+	if (void *fence = batch.fences[batch.region]) {
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fence);
+		batch.fences[batch.region] = 0;
+	}
+
+	ptrdiff_t first = (ptrdiff_t)batch.region * batch.region_limit + batch.offset;
+	ptrdiff_t size = (ptrdiff_t)sizeof(quad) * (batch.region_limit - batch.offset);
+	u32 access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	batch.quads = (quad *)glMapBufferRange(GL_ARRAY_BUFFER, first * (ptrdiff_t)sizeof(quad), size, access);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	assert(batch.quads);
+}
+
+// points the instanced attributes at the quad with the given index. GL 3.3
+// has no base instance for instanced draws, so this is done per draw.
+internal void
+bind_quads(u32 vbo, i32 first)
+{
+	size_t offset = sizeof(quad) * (size_t)first;
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(0, 4, GL_SHORT, false, sizeof(quad), (void *)(offset + offsetof(quad, x0)));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_SHORT, false, sizeof(quad), (void *)(offset + offsetof(quad, u0)));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, true, sizeof(quad), (void *)(offset + offsetof(quad, color)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+internal inline u64
+pipeline_key(const draw_command& c)
+{
+	return ((u64)c.program << 40) | ((u64)c.texture << 8) | c.blend;
+}
+
+internal void
+flush_batch(app_state *state)
+{
+	profile_function();
+
+	render_batch& batch = state->batch;
+
+	if (!batch.quads) {
+		clear(batch.commands);
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+	u8 ok = glUnmapBuffer(GL_ARRAY_BUFFER);
+	assert(ok);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	draw_command *last = batch.commands.data + batch.commands.count - 1;
+	last->count = batch.count - last->first;
+
+	upload_atlas(state, state->atlas);
+	upload_atlas(state, state->sdf_atlas);
+
+	// commands are drawn in submission order, which is the order things
+	// overlap in. sorting them by state would draw text on a later page,
+	// or with another program, over rectangles submitted after it.
+	i32 base = batch.region * batch.region_limit + batch.offset;
+
+	draw_command *c = begin(batch.commands);
+	draw_command *e = end(batch.commands);
+	draw_command *bound = 0;
+
+	while (c != e) {
+		// merge runs of the same state that are adjacent in the quad
+		// buffer into a single draw.
+		i32 count = c->count;
+		draw_command *n = c + 1;
+		while (n != e && pipeline_key(*n) == pipeline_key(*c) && n->first == c->first + count) {
+			count += n->count;
+			++n;
+		}
+
+		if (count > 0) {
+			if (!bound || bound->program != c->program)
+				glUseProgram(c->program);
+			if (!bound || bound->texture != c->texture)
+				glBindTexture(GL_TEXTURE_2D, c->texture);
+			if (!bound || bound->blend != c->blend) {
+				if (c->blend == BLEND_PREMULTIPLIED) {
+					glEnable(GL_BLEND);
+					glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+				}
+				else {
+					glDisable(GL_BLEND);
+				}
+			}
+			bound = c;
+
+			bind_quads(batch.vbo, base + c->first);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+			++batch.stats.draw_count;
+		}
+
+		c = n;
+	}
+
+	glUseProgram(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	glDisable(GL_BLEND);
 
-	cursor.x = x;
-	cursor.y = y;
-	return cursor;
+	batch.offset += batch.count;
+
+	batch.stats.quad_count += batch.count;
+	batch.stats.upload_bytes += (i64)sizeof(quad) * batch.count;
+
+	batch.quads = 0;
+	batch.count = 0;
+	clear(batch.commands);
+}
+
+// fences the current region after the draws that read it and moves on to
+// the next one. the batch must be flushed.
+internal void
+finish_region(render_batch& batch)
+{
+	assert(!batch.quads);
+
+	if (batch.offset == 0)
+		return;
+
+	batch.fences[batch.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	batch.region = (batch.region + 1) % STREAM_REGIONS;
+	batch.offset = 0;
+}
+
+// returns room for n quads in the mapped region. if the region is full the
+// batch is flushed and recording continues in the next region with the
+// current pipeline state.
+internal quad *
+push_quads(app_state *state, i32 n)
+{
+	render_batch& batch = state->batch;
+
+	assert(!is_empty(batch.commands));
+	assert(n <= batch.region_limit);
+
+	if (batch.offset + batch.count + n > batch.region_limit) {
+		draw_command current = batch.commands.data[batch.commands.count - 1];
+		flush_batch(state);
+		finish_region(batch);
+		use_pipeline(batch, current.program, current.texture, current.blend);
+	}
+
+	if (!batch.quads)
+		map_region(batch);
+
+	quad *result = batch.quads + batch.count;
+	batch.count += n;
+	return result;
+}
+
+internal inline u32
+pack_color(vec4 c)
+{
+	u32 r = (u32)(c.r * 255.f + 0.5f);
+	u32 g = (u32)(c.g * 255.f + 0.5f);
+	u32 b = (u32)(c.b * 255.f + 0.5f);
+	u32 a = (u32)(c.a * 255.f + 0.5f);
+	return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+internal inline void
+mesh_rect2d(app_state *state, i32 x0, i32 y0, i32 x1, i32 y1, i32 u0, i32 v0, i32 u1, i32 v1, u32 color)
+{
+	quad *q = push_quads(state, 1);
+
+	q->x0 = (i16)x0;
+	q->y0 = (i16)y0;
+	q->x1 = (i16)x1;
+	q->y1 = (i16)y1;
+	q->u0 = (u16)u0;
+	q->v0 = (u16)v0;
+	q->u1 = (u16)u1;
+	q->v1 = (u16)v1;
+	q->color = color;
+}
+
+////////
+//
+// gpu timing. a frame is split into named passes, and a timestamp query
+// after the draws of every pass measures the gpu time each one took.
+
+#define GPU_LOG_FILE	"gpu_times.csv"
+
+internal void
+init_gpu_timer(gpu_timer& t)
+{
+	for (gpu_frame& f : t.frames)
+		glGenQueries(GPU_MAX_PASSES + 1, f.queries);
+}
+
+// forgets the frames in flight and their results, whose pass names may be
+// in code that has been unloaded.
+internal void
+reset_gpu_timer(gpu_timer& t)
+{
+	for (gpu_frame& f : t.frames) {
+		f.pass_count = 0;
+		f.pending = false;
+	}
+	t.current = 0;
+	t.pass_count = 0;
+}
+
+internal void
+flush_gpu_log(gpu_timer& t)
+{
+	if (t.log_used > 0)
+		sys_write_file(GPU_LOG_FILE, t.log_buf, (size_t)t.log_used, true);
+	t.log_used = 0;
+}
+
+// one line per pass: frame, pass, nanoseconds.
+internal void
+log_gpu_times(gpu_timer& t)
+{
+	for (i32 i = 0; i < t.pass_count; ++i) {
+		char line[128];
+		char *end = line + sizeof(line);
+		char *p = fmt(line, end, "%d,", (i32)t.result_frame);
+		p = copy_string(p, end, t.names[i]);
+		p = fmt(p, end, ",%d\n", (i32)t.times[i]);
+
+		i32 n = (i32)(p - line);
+		if (t.log_used + n > (i32)sizeof(t.log_buf))
+			flush_gpu_log(t);
+		copy_n(n, t.log_buf + t.log_used, line);
+		t.log_used += n;
+	}
+}
+
+internal void
+read_gpu_frame(gpu_timer& t, gpu_frame& f)
+{
+	u64 start;
+	glGetQueryObjectui64v(f.queries[0], GL_QUERY_RESULT, &start);
+
+	for (i32 i = 0; i < f.pass_count; ++i) {
+		u64 end;
+		glGetQueryObjectui64v(f.queries[i + 1], GL_QUERY_RESULT, &end);
+		t.names[i] = f.names[i];
+		t.times[i] = end - start;
+		start = end;
+	}
+	t.pass_count = f.pass_count;
+	t.result_frame = f.frame;
+	f.pending = false;
+
+	if (t.log)
+		log_gpu_times(t);
+}
+
+// reads back the frames the gpu has finished, oldest first, and starts
+// timing a new one.
+internal void
+begin_gpu_frame(app_state *state)
+{
+	profile_function();
+
+	gpu_timer& t = state->gpu;
+
+	for (u32 i = 0; i < GPU_TIMER_FRAMES; ++i) {
+		gpu_frame& f = t.frames[(state->frame + i) % GPU_TIMER_FRAMES];
+		if (!f.pending)
+			continue;
+
+		// queries complete in order, so later frames are not done either.
+		i32 available = 0;
+		glGetQueryObjectiv(f.queries[f.pass_count], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		read_gpu_frame(t, f);
+	}
+
+	gpu_frame& f = t.frames[state->frame % GPU_TIMER_FRAMES];
+	if (f.pending) {
+		f.pending = false;
+		++t.dropped;
+	}
+
+	f.frame = state->frame;
+	f.pass_count = 0;
+	t.current = &f;
+
+	glQueryCounter(f.queries[0], GL_TIMESTAMP);
+}
+
+// ends the current pass and starts the next one. everything recorded so
+// far is drawn first, so it is counted in the pass it was recorded in.
+internal void
+gpu_pass(app_state *state, const char *name)
+{
+	gpu_frame& f = *state->gpu.current;
+
+	flush_batch(state);
+
+	if (f.pass_count > 0)
+		glQueryCounter(f.queries[f.pass_count], GL_TIMESTAMP);
+
+	assert(f.pass_count < GPU_MAX_PASSES);
+	f.names[f.pass_count++] = name;
+}
+
+internal void
+end_gpu_frame(app_state *state)
+{
+	gpu_frame& f = *state->gpu.current;
+
+	flush_batch(state);
+
+	glQueryCounter(f.queries[f.pass_count], GL_TIMESTAMP);
+	f.pending = true;
+	state->gpu.current = 0;
+}
+
+////////
+//
+// text layout cache. a string is laid out once into quads relative to its
+// origin, keyed by font, string and color, with each glyph pair kerned
+// along the way. drawing it again only translates the quads into the
+// batch and marks their glyphs as used. layouts not drawn for
+// LAYOUT_EVICT_AGE frames are evicted, the least recently used one when
+// the cache is full, and all of them when the atlas moves glyphs.
+
+internal u64
+hash_bytes(const void *p, size_t n)
+{
+	// fnv-1a
+	u64 h = 0xCBF29CE484222325ull;
+	for (const u8 *b = (const u8 *)p, *e = b + n; b != e; ++b)
+		h = (h ^ *b) * 0x100000001B3ull;
+	return h;
+}
+
+internal inline u32
+layout_key(struct font *font, u64 hash, u32 color, f32 scale)
+{
+	u64 k = hash ^ (u64)(uintptr_t)font * 0x9E3779B97F4A7C15ull ^ (u64)color << 29 ^ (u64)(scale * 4096.f) << 7;
+	u32 key = (u32)(k ^ (k >> 32));
+	return key == index_map<i32>::empty_key ? 0 : key;
+}
+
+internal void
+evict_layout(layout_cache& c, i32 slot)
+{
+	text_layout& l = c.slots[slot];
+	remove(c.map, layout_key(l.font, l.hash, l.color, l.scale));
+	l.font = 0;
+	c.free_slots[c.free_count++] = slot;
+}
+
+// drops every layout. the atlas calls this before it moves glyphs.
+internal void
+invalidate_layouts(layout_cache& c)
+{
+	for (i32 i = 0; i < LAYOUT_CACHE_SIZE; ++i)
+		if (c.slots[i].font)
+			evict_layout(c, i);
+
+	++c.generation;
+}
+
+internal void
+init_layout_cache(layout_cache& c)
+{
+	for (i32 i = LAYOUT_CACHE_SIZE; i-- > 0;)
+		c.free_slots[c.free_count++] = i;
+}
+
+// evicts layouts that were not drawn for a while and starts counting hits
+// for a new frame.
+internal void
+age_layouts(app_state *state)
+{
+	layout_cache& c = state->layouts;
+
+	for (i32 i = 0; i < LAYOUT_CACHE_SIZE; ++i)
+		if (c.slots[i].font && state->frame - c.slots[i].last_used > LAYOUT_EVICT_AGE)
+			evict_layout(c, i);
+
+	c.last_hits = c.hits;
+	c.last_misses = c.misses;
+	c.hits = 0;
+	c.misses = 0;
+}
+
+internal text_layout *
+find_layout(layout_cache& c, struct font *font, u64 hash, u32 color, f32 scale)
+{
+	i32 *slot = find(c.map, layout_key(font, hash, color, scale));
+	if (!slot)
+		return 0;
+
+	text_layout& l = c.slots[*slot];
+	if (l.font != font || l.hash != hash || l.color != color || l.scale != scale)
+		return 0;
+
+	return &l;
+}
+
+internal inline i32
+cached_kerning(kern_entry *cache, struct font *font, u32 left, u32 right)
+{
+	if (!font->ttf || !left || !right)
+		return 0;
+
+	u32 pair = left << 16 | right;
+	u32 h = ((pair ^ (u32)((uintptr_t)font >> 4)) * 0x9E3779B1u) >> 20;
+	kern_entry& e = cache[h & (KERN_CACHE_SIZE - 1)];
+	if (e.font != font || e.pair != pair) {
+		e.font = font;
+		e.pair = pair;
+		e.kerning = kerning(font, left, right);
+	}
+
+	return e.kerning;
+}
+
+// moves the layout built in the scratch slot into the cache. its arrays
+// trade places with those of the slot it replaces, so memory is reused.
+internal void
+keep_layout(app_state *state)
+{
+	layout_cache& c = state->layouts;
+
+	if (c.free_count == 0) {
+		i32 oldest = 0;
+		for (i32 i = 1; i < LAYOUT_CACHE_SIZE; ++i)
+			if (state->frame - c.slots[i].last_used > state->frame - c.slots[oldest].last_used)
+				oldest = i;
+		evict_layout(c, oldest);
+	}
+
+	// a layout whose key collides with another replaces it.
+	text_layout& scratch = c.scratch;
+	if (i32 *other = find(c.map, layout_key(scratch.font, scratch.hash, scratch.color, scratch.scale)))
+		evict_layout(c, *other);
+
+	i32 slot = c.free_slots[--c.free_count];
+	text_layout& l = c.slots[slot];
+
+	text_layout t = l;
+	l = scratch;
+	scratch = t;
+
+	insert(c.map, layout_key(l.font, l.hash, l.color, l.scale), slot);
+}
+
+internal void
+add_layout_quad(text_layout& l, i32 page, i32 glyph, i32 x0, i32 y0, i32 x1, i32 y1, i32 u0, i32 v0, i32 u1, i32 v1, u32 color)
+{
+	if (is_empty(l.runs) || l.runs.data[l.runs.count - 1].page != page) {
+		layout_run *run = allocate_n(l.runs, 1);
+		run->page = page;
+		run->count = 0;
+	}
+	++l.runs.data[l.runs.count - 1].count;
+
+	quad *q = allocate_n(l.quads, 1);
+	q->x0 = (i16)x0;
+	q->y0 = (i16)y0;
+	q->x1 = (i16)x1;
+	q->y1 = (i16)y1;
+	q->u0 = (u16)u0;
+	q->v0 = (u16)v0;
+	q->u1 = (u16)u1;
+	q->v1 = (u16)v1;
+	q->color = color;
+
+	*allocate_n(l.glyphs, 1) = glyph;
+}
+
+// moves the pen past one codepoint, adding the quad of its glyph. the pen
+// and the glyph metrics are scaled by l.scale and quads are rounded to
+// whole pixels; at scale 1 everything stays on the pixel grid. previous is
+// the glyph id before the codepoint, which the pair is kerned by.
+internal inline void
+layout_codepoint(app_state *state, text_layout& l, u32 codepoint, f32& x, f32& y, u32& previous, vec4 color, u32 packed_color)
+{
+	struct font *font = l.font;
+	f32 scale = l.scale;
+
+	if (codepoint == '\n') {
+		y -= (f32)floor_i32(line_height(font) * scale + .5f);
+		x = 0;
+		previous = 0;
+		return;
+	}
+
+	struct glyph *glyph = render_glyph(state, font, codepoint);
+	i32 index = (i32)(glyph - font->glyphs.data);
+
+	x += (f32)cached_kerning(state->layouts.kerning, font, previous, glyph->id) * scale;
+	previous = glyph->id;
+
+	if (glyph->page == GLYPH_PENDING) {
+		// draw a faint box until the glyph arrives.
+		f32 advance = (f32)(glyph->xadv ? glyph->xadv : font->average_width) * scale;
+		i32 x0 = floor_i32(x + 1.5f);
+		i32 y0 = floor_i32(y + (f32)font->height * scale / 4.f + .5f);
+		i32 x1 = floor_i32(x + advance - .5f);
+		i32 y1 = floor_i32(y + 3.f * (f32)font->height * scale / 4.f + .5f);
+		vec4 faint = { color.r * .25f, color.g * .25f, color.b * .25f, color.a * .25f };
+
+		add_layout_quad(l, 0, index, x0, y0, x1, y1, 1, 1, 1, 1, pack_color(faint));
+		l.pending = true;
+
+		x += advance;
+	}
+	else {
+		if (is_packed(*glyph)) {
+			i32 x0 = floor_i32(x + (f32)glyph->dx * scale + .5f);
+			i32 y0 = floor_i32(y + (f32)glyph->dy * scale + .5f);
+			i32 x1 = floor_i32(x + (f32)(glyph->dx + glyph->x1 - glyph->x0) * scale + .5f);
+			i32 y1 = floor_i32(y + (f32)(glyph->dy + glyph->y1 - glyph->y0) * scale + .5f);
+
+			add_layout_quad(l, glyph->page, index, x0, y0, x1, y1, glyph->x0, glyph->y0, glyph->x1, glyph->y1, packed_color);
+		}
+
+		x += (f32)glyph->xadv * scale;
+	}
+}
+
+// lays out n bytes of utf-8 text into the scratch layout.
+internal void
+layout_text(app_state *state, struct font *font, const char *s, size_t n, u64 hash, vec4 color, f32 scale)
+{
+	profile_function();
+
+	layout_cache& c = state->layouts;
+	text_layout& l = c.scratch;
+
+	// rasterizing a glyph may repack the atlas, which moves the glyphs laid
+	// out before it, so the text is laid out again until a pass repacks
+	// nothing. text that doesn't fit the atlas at once can repack on every
+	// pass; its last try is drawn but not kept, like a pending one.
+	u32 generation = c.generation;
+	for (i32 attempt = 0; attempt < LAYOUT_ATTEMPTS; ++attempt) {
+		l.font = font;
+		l.hash = hash;
+		l.color = pack_color(color);
+		l.scale = scale;
+		l.last_used = state->frame;
+		l.pending = false;
+		clear(l.quads);
+		clear(l.glyphs);
+		clear(l.runs);
+
+		f32 x = 0;
+		f32 y = 0;
+		u32 previous = 0;
+
+		utf8_reader r = { (const u8 *)s, (const u8 *)s + n, 0 };
+
+		while (r.at < r.end) {
+			const u8 *ascii_end = r.at + ascii_prefix(r.at, (size_t)(r.end - r.at));
+			while (r.at < ascii_end)
+				layout_codepoint(state, l, *r.at++, x, y, previous, color, l.color);
+
+			if (r.at < r.end)
+				layout_codepoint(state, l, next_codepoint(r), x, y, previous, color, l.color);
+		}
+
+		l.dx = floor_i32(x + .5f);
+		l.dy = floor_i32(y + .5f);
+
+		bool moved = c.generation != generation;
+		if (!moved || attempt == LAYOUT_ATTEMPTS - 1) {
+			state->utf8_errors += r.errors;
+			l.pending = l.pending || moved;
+			break;
+		}
+		generation = c.generation;
+	}
+}
+
+// copies the quads of a layout into the batch, moved to x, y.
+internal void
+draw_layout(app_state *state, text_layout& l, i32 x, i32 y)
+{
+	const quad *src = l.quads.data;
+
+	glyph_atlas& atlas = font_atlas(state, l.font);
+	u32 program = l.font->sdf_spread ? state->sdf_program : state->texture_program;
+
+	for (layout_run& run : l.runs) {
+		u32 texture = atlas.pages[run.page].texture;
+
+		for (i32 left = run.count; left > 0;) {
+			i32 n = min(left, state->batch.region_limit);
+
+			use_pipeline(state->batch, program, texture, BLEND_PREMULTIPLIED);
+			quad *dst = push_quads(state, n);
+
+			for (i32 i = 0; i < n; ++i) {
+				quad q = src[i];
+				q.x0 = (i16)(q.x0 + x);
+				q.y0 = (i16)(q.y0 + y);
+				q.x1 = (i16)(q.x1 + x);
+				q.y1 = (i16)(q.y1 + y);
+				dst[i] = q;
+			}
+
+			src += n;
+			left -= n;
+		}
+	}
+
+	glyph *glyphs = l.font->glyphs.data;
+	for (i32 g : l.glyphs)
+		glyphs[g].last_used = state->frame;
+
+	l.last_used = state->frame;
+}
+
+// draws n bytes of utf-8 text at scale times the size of the font. only
+// distance field fonts stay sharp when scaled.
+internal vec2
+draw_text(app_state *state, struct font *font, const char *s, size_t n, vec2 cursor, vec4 color, f32 scale = 1.f)
+{
+	profile_function();
+
+	layout_cache& c = state->layouts;
+
+	u64 hash = hash_bytes(s, n);
+	u32 packed_color = pack_color(color);
+	text_layout *l = find_layout(c, font, hash, packed_color, scale);
+
+	if (l) {
+		++c.hits;
+	}
+	else {
+		++c.misses;
+
+		layout_text(state, font, s, n, hash, color, scale);
+		l = &c.scratch;
+
+		// layouts with glyphs that are still being rasterized are drawn
+		// from scratch until they are complete.
+		if (!l->pending) {
+			keep_layout(state);
+			l = find_layout(c, font, hash, packed_color, scale);
+		}
+	}
+
+	i32 x = (i32)round(cursor.x);
+	i32 y = (i32)round(cursor.y);
+	draw_layout(state, *l, x, y);
+
+	cursor.x = (f32)(x + l->dx);
+	cursor.y = (f32)(y + l->dy);
+	return cursor;
+}
+
+internal vec2
+draw_text(app_state *state, struct font *font, const char *s, vec2 cursor, vec4 color, f32 scale = 1.f)
+{
+	return draw_text(state, font, s, string_length(s), cursor, color, scale);
+}
+
+internal inline void
+draw_rect2d(app_state *state, rect2d position, vec4 color)
+{
+	i32 x0 = (i32)round(position.x0);
+	i32 y0 = (i32)round(position.y0);
+	i32 x1 = (i32)round(position.x1);
+	i32 y1 = (i32)round(position.y1);
+
+	// a degenerate rectangle in the middle of the white block.
+	i32 t = 1;
+
+	use_pipeline(state->batch, state->texture_program, state->atlas.pages[0].texture, BLEND_PREMULTIPLIED);
+	mesh_rect2d(state, x0, y0, x1, y1, t, t, t, t, pack_color(color));
+}
+
+////////
+//
+// console. appended text goes into a ring of bytes and every line is the
+// position in the text stream where it starts, kept in a ring of its own,
+// so a line costs 8 bytes plus its text. both rings are reserved up front
+// and committed as they fill. lines whose text has been overwritten, or
+// that no longer fit in the line ring, are dropped from the front. only
+// the lines in the viewport are ever laid out.
+
+internal inline u64
+console_line_start(const text_console& c, u64 line)
+{
+	return c.lines[line & (CONSOLE_MAX_LINES - 1)];
+}
+
+internal inline u64
+console_line_end(const text_console& c, u64 line)
+{
+	return line + 1 < c.line_end ? console_line_start(c, line + 1) : c.head;
+}
+
+internal void
+init_console(text_console& c)
+{
+	init_arena(c.text_arena, "console text", CONSOLE_TEXT_SIZE);
+	init_arena(c.line_arena, "console lines", CONSOLE_MAX_LINES * sizeof(u64));
+	c.text = c.text_arena.memory;
+	c.lines = (u64 *)c.line_arena.memory;
+}
+
+internal void
+start_console_line(text_console& c)
+{
+	if (c.line_end - c.first_line == CONSOLE_MAX_LINES)
+		++c.first_line;
+
+	if (c.line_end < CONSOLE_MAX_LINES)
+		set_arena_end(c.line_arena, (size_t)(c.line_end + 1) * sizeof(u64));
+
+	c.lines[c.line_end & (CONSOLE_MAX_LINES - 1)] = c.head;
+	++c.line_end;
+	c.open = true;
+}
+
+internal void
+write_console_text(text_console& c, const char *s, size_t n)
+{
+	if (c.head < CONSOLE_TEXT_SIZE)
+		set_arena_end(c.text_arena, (size_t)min(c.head + n, (u64)CONSOLE_TEXT_SIZE));
+
+	size_t at = (size_t)(c.head & (CONSOLE_TEXT_SIZE - 1));
+	size_t k = min(n, CONSOLE_TEXT_SIZE - at);
+	copy_bytes(c.text + at, s, k);
+	copy_bytes(c.text, s + k, n - k);
+	c.head += n;
+}
+
+// appends n bytes of text. lines end at newlines, and lines longer than
+// CONSOLE_MAX_LINE are split so that no line costs more than that to lay
+// out or keep.
+internal void
+append_console(text_console& c, const char *s, size_t n)
+{
+	u64 start_ticks = sys_ticks();
+	u64 line_end = c.line_end;
+
+	const char *end = s + n;
+	while (s < end) {
+		if (!c.open)
+			start_console_line(c);
+
+		u64 room = CONSOLE_MAX_LINE - (c.head - console_line_start(c, c.line_end - 1));
+		const char *e = s;
+		while (e < end && *e != '\n' && (u64)(e - s) < room)
+			++e;
+
+		write_console_text(c, s, (size_t)(e - s));
+
+		if (e < end && *e == '\n') {
+			c.open = false;
+			++e;
+		}
+		else if ((u64)(e - s) == room) {
+			c.open = false;
+		}
+
+		s = e;
+	}
+
+	// the open line is never overwritten, it is much shorter than the ring.
+	while (c.first_line < c.line_end && console_line_start(c, c.first_line) + CONSOLE_TEXT_SIZE < c.head)
+		++c.first_line;
+
+	// a view scrolled back into the history stays on the same lines.
+	if (c.scroll > 0)
+		c.scroll += (i64)(c.line_end - line_end);
+
+	c.appended_lines += c.line_end - line_end;
+	c.append_ticks += sys_ticks() - start_ticks;
+}
+
+// the text of a line and its length. a line that wraps around the end of
+// the ring comes back as a copy in the frame arena.
+internal const char *
+console_line_text(app_state *state, text_console& c, u64 line, size_t *n)
+{
+	u64 start = console_line_start(c, line);
+	*n = (size_t)(console_line_end(c, line) - start);
+
+	size_t at = (size_t)(start & (CONSOLE_TEXT_SIZE - 1));
+	const char *s = (const char *)c.text + at;
+
+	if (at + *n > CONSOLE_TEXT_SIZE) {
+		char *copy = (char *)push_arena(state->frame_arena, *n, 1, 0);
+		size_t k = CONSOLE_TEXT_SIZE - at;
+		copy_bytes(copy, s, k);
+		copy_bytes(copy + k, c.text, *n - k);
+		s = copy;
+	}
+
+	return s;
+}
+
+// draws the first columns codepoints of a line, counted by their first
+// byte.
+internal void
+draw_line(app_state *state, struct font *font, const char *s, size_t n, i32 columns, vec2 cursor, vec4 color)
+{
+	size_t cut = 0;
+	for (i32 column = 0; cut < n; ++cut)
+		if (((u8)s[cut] & 0xC0) != 0x80 && column++ == columns)
+			break;
+
+	draw_text(state, font, s, cut, cursor, color);
+}
+
+// draws the lines that fit into view, the newest at the bottom unless the
+// view is scrolled back. lines are cut at the width of the view.
+internal void
+draw_console(app_state *state, text_console& c, rect2d view, vec4 color)
+{
+	profile_function();
+
+	struct font *font = state->console_font;
+	f32 height = line_height(font);
+
+	i64 rows = (i64)((view.y1 - view.y0) / height);
+	i64 count = (i64)(c.line_end - c.first_line);
+	c.scroll = max((i64)0, min(c.scroll, count - rows));
+
+	u64 last = c.line_end - (u64)c.scroll;
+	u64 first = last - (u64)min(rows, count);
+
+	i32 columns = (i32)((view.x1 - view.x0) / (f32)font->average_width);
+
+	vec2 cursor = { view.x0, view.y1 - height };
+	for (u64 i = first; i < last; ++i) {
+		size_t n;
+		const char *s = console_line_text(state, c, i, &n);
+		draw_line(state, font, s, n, columns, cursor, color);
+		cursor.y -= height;
+	}
+}
+
+// appends lines that look like a busy server log, for trying the console
+// with lots of text.
+internal void
+fill_console(text_console& c, i32 lines)
+{
+	profile_function();
+
+	char buf[4096];
+	char *end = buf + sizeof(buf);
+	char *p = buf;
+
+	u64 first = c.line_end;
+	for (i32 i = 0; i < lines; ++i) {
+		i32 n = (i32)(first + (u64)i);
+		if (end - p < 128) {
+			append_console(c, buf, (size_t)(p - buf));
+			p = buf;
+		}
+
+		p = fmt(p, end, "[%09d] ", n);
+		p = fmt(p, end, "worker %d: ", n % 7);
+		p = fmt(p, end, "request %08x", (i32)(((u32)n * 2654435761u) >> 4));
+		p = fmt(p, end, " done in %d ms\n", n % 97);
+	}
+
+	append_console(c, buf, (size_t)(p - buf));
+}
+
+////////
+//
+// panels. ctrl+t splits the console view into a grid of panels that show
+// consecutive stretches of its history, a screen dense with text. they are
+// laid out and meshed in parallel: a job on every worker thread, and the
+// render thread itself, claim panels one at a time until none are left and
+// record their quads and draw commands with the panel_recorder of their
+// thread. the render thread then copies them into the batch in panel
+// order, so what is drawn does not depend on which thread recorded which
+// panel.
+//
+// recording only reads the fonts and the atlas, which nothing changes
+// until all panels are recorded. glyphs that are not resident are noted
+// instead, and requested by the render thread once every panel is done.
+
+struct panel_line
+{
+	const char *s;
+	size_t n;
+};
+
+struct panel
+{
+	// pen position of the first line.
+	f32 x;
+	f32 y;
+
+	i32 columns;
+	i32 line_count;
+	panel_line *lines;
+
+	// the recorder that recorded it, and what it left there.
+	i32 recorder;
+	i32 first_command;
+	i32 command_count;
+	i32 first_miss;
+	i32 miss_count;
+	u32 pad;
+};
+
+internal inline void
+record_quad(panel_recorder& r, panel& p, u32 program, u32 texture, const quad& q)
+{
+	draw_command *c = 0;
+	if (p.command_count > 0)
+		c = (draw_command *)r.commands.memory + p.first_command + p.command_count - 1;
+
+	if (!c || c->texture != texture) {
+		c = allocate<draw_command>(&r.commands.base, 1);
+		c->program = program;
+		c->texture = texture;
+		c->blend = BLEND_PREMULTIPLIED;
+		c->first = (i32)(r.quads.used / sizeof(quad));
+		c->count = 0;
+		++p.command_count;
+	}
+
+	*allocate<quad>(&r.quads.base, 1) = q;
+	++c->count;
+}
+
+// records the first p.columns codepoints of a line with the pen at x, y,
+// placing glyphs the way layout_codepoint does at scale 1.
+internal void
+record_line(app_state *state, panel_recorder& r, panel& p, panel_line line, f32 x, f32 y, u32 color, u32 faint)
+{
+	struct font *font = state->console_font;
+	glyph_atlas& atlas = font_atlas(state, font);
+	u32 program = font->sdf_spread ? state->sdf_program : state->texture_program;
+
+	u32 previous = 0;
+
+	utf8_reader u = { (const u8 *)line.s, (const u8 *)line.s + line.n, 0 };
+	for (i32 column = 0; column < p.columns && u.at < u.end; ++column) {
+		u32 codepoint = next_codepoint(u);
+		struct glyph *g = find_glyph(font, codepoint);
+
+		if (!g || g->page == GLYPH_UNLOADED) {
+			*allocate<u32>(&r.misses.base, 1) = codepoint;
+			++p.miss_count;
+			x += (f32)(g && g->xadv ? g->xadv : font->average_width);
+			previous = 0;
+			continue;
+		}
+
+		x += (f32)cached_kerning(r.kerning, font, previous, g->id);
+		previous = g->id;
+
+		// other threads may store the same frame into the same glyph. the
+		// load skips the store, and the cache line stays shared, when one
+		// already did.
+		if (atomic_load(&g->last_used) != state->frame)
+			atomic_store(&g->last_used, state->frame);
+
+		quad q;
+		if (g->page == GLYPH_PENDING) {
+			f32 advance = (f32)(g->xadv ? g->xadv : font->average_width);
+			q.x0 = (i16)floor_i32(x + 1.5f);
+			q.y0 = (i16)floor_i32(y + (f32)font->height / 4.f + .5f);
+			q.x1 = (i16)floor_i32(x + advance - .5f);
+			q.y1 = (i16)floor_i32(y + 3.f * (f32)font->height / 4.f + .5f);
+			q.u0 = q.v0 = q.u1 = q.v1 = 1;
+			q.color = faint;
+			record_quad(r, p, program, atlas.pages[0].texture, q);
+
+			x += advance;
+			continue;
+		}
+
+		if (is_packed(*g)) {
+			q.x0 = (i16)floor_i32(x + (f32)g->dx + .5f);
+			q.y0 = (i16)floor_i32(y + (f32)g->dy + .5f);
+			q.x1 = (i16)floor_i32(x + (f32)(g->dx + g->x1 - g->x0) + .5f);
+			q.y1 = (i16)floor_i32(y + (f32)(g->dy + g->y1 - g->y0) + .5f);
+			q.u0 = (u16)g->x0;
+			q.v0 = (u16)g->y0;
+			q.u1 = (u16)g->x1;
+			q.v1 = (u16)g->y1;
+			q.color = color;
+			record_quad(r, p, program, atlas.pages[g->page].texture, q);
+		}
+
+		x += (f32)g->xadv;
+	}
+
+	r.utf8_errors += u.errors;
+}
+
+internal void
+record_panel(app_state *state, panel_recorder& r, panel& p, u32 color, u32 faint)
+{
+	p.first_command = (i32)(r.commands.used / sizeof(draw_command));
+	p.command_count = 0;
+	p.first_miss = (i32)(r.misses.used / sizeof(u32));
+	p.miss_count = 0;
+
+	f32 height = line_height(state->console_font);
+	f32 x = round(p.x);
+	for (i32 i = 0; i < p.line_count; ++i)
+		record_line(state, r, p, p.lines[i], x, round(p.y - (f32)i * height), color, faint);
+
+	++r.panels;
+}
+
+// claims panels until none are left. worker is the index of the thread,
+// the render thread's is the number of workers.
+internal void
+claim_panels(panel_job& job, i32 worker)
+{
+	app_state *state = job.state;
+	panel_recorder& r = state->panels.recorders[worker];
+
+	for (u32 i; (i = atomic_add(&job.next, 1)) < (u32)job.count;) {
+		job.panels[i].recorder = worker;
+		record_panel(state, r, job.panels[i], job.color, job.faint);
+		atomic_add(&job.done, 1);
+	}
+}
+
+internal void
+record_panels_job(i32 worker, void *data)
+{
+	profile_function();
+
+	panel_job& job = *(panel_job *)data;
+	atomic_add(&job.queued, (u32)-1);
+	claim_panels(job, worker);
+}
+
+// records every panel, spread over the render thread and the workers, and
+// requests the glyphs that were missing.
+internal void
+record_panels(app_state *state, panel_job& job)
+{
+	panel_view& v = state->panels;
+	i32 threads = state->workers.count + 1;
+
+	for (i32 i = 0; i < threads; ++i) {
+		panel_recorder& r = v.recorders[i];
+		if (!r.quads.memory) {
+			init_arena(r.quads, "panel quads", RECORD_QUADS_RESERVE);
+			init_arena(r.commands, "panel commands", RECORD_COMMANDS_RESERVE);
+			init_arena(r.misses, "panel misses", RECORD_MISSES_RESERVE);
+		}
+		reset_arena(r.quads);
+		reset_arena(r.commands);
+		reset_arena(r.misses);
+		r.utf8_errors = 0;
+		r.panels = 0;
+	}
+
+	// workers whose last job is still queued find the new panels with it.
+	atomic_store(&job.done, 0);
+	atomic_store(&job.next, 0);
+	while (atomic_load(&job.queued) < (u32)state->workers.count) {
+		atomic_add(&job.queued, 1);
+		sys_add_work(record_panels_job, &job);
+	}
+
+	// the render thread records too rather than wait, and then only waits
+	// for the panels other threads are still recording. the rest of the
+	// queue, glyphs included, is left to the workers. a worker that was
+	// descheduled in the middle of a panel gets the cpu back by yielding.
+	claim_panels(job, state->workers.count);
+	for (i32 spins = 0; atomic_load(&job.done) < (u32)job.count; ++spins) {
+		if (spins < PANEL_SPINS)
+			cpu_relax();
+		else
+			sys_yield();
+	}
+
+	struct font *font = state->console_font;
+	for (i32 i = 0; i < threads; ++i) {
+		panel_recorder& r = v.recorders[i];
+		const u32 *misses = (const u32 *)r.misses.memory;
+		for (size_t k = 0, n = r.misses.used / sizeof(u32); k < n; ++k)
+			render_glyph(state, font, misses[k]);
+	}
+}
+
+// draws the console into a grid of panels, its lines in reading order with
+// the newest at the bottom right unless the view is scrolled back.
+internal void
+draw_panels(app_state *state, text_console& c, rect2d view, vec4 color)
+{
+	profile_function();
+
+	panel_view& v = state->panels;
+	struct font *font = state->console_font;
+	f32 height = line_height(font);
+
+	f32 w = (view.x1 - view.x0 + PANEL_GAP) / PANEL_COLUMNS - PANEL_GAP;
+	f32 h = (view.y1 - view.y0 + PANEL_GAP) / PANEL_ROWS - PANEL_GAP;
+	i64 rows = (i64)(h / height);
+	if (rows <= 0 || w <= 0)
+		return;
+
+	i32 count = PANEL_COLUMNS * PANEL_ROWS;
+	i64 lines = (i64)(c.line_end - c.first_line);
+	c.scroll = max((i64)0, min(c.scroll, lines - rows * count));
+
+	u64 last = c.line_end - (u64)c.scroll;
+	u64 line = last - (u64)min(rows * count, lines);
+
+	panel *panels = allocate<panel>(&state->frame_arena.base, (size_t)count, ALLOCATE_ZERO);
+	for (i32 i = 0; i < count; ++i) {
+		panel& p = panels[i];
+		p.x = view.x0 + (f32)(i % PANEL_COLUMNS) * (w + PANEL_GAP);
+		p.y = view.y1 - (f32)(i / PANEL_COLUMNS) * (h + PANEL_GAP) - height;
+		p.columns = (i32)(w / (f32)font->average_width);
+		p.line_count = (i32)min((u64)rows, last - line);
+		p.lines = allocate<panel_line>(&state->frame_arena.base, (size_t)p.line_count);
+		for (i32 k = 0; k < p.line_count; ++k)
+			p.lines[k].s = console_line_text(state, c, line++, &p.lines[k].n);
+	}
+
+	vec4 faint = { color.r * .25f, color.g * .25f, color.b * .25f, color.a * .25f };
+	panel_job& job = v.job;
+	job.state = state;
+	job.panels = panels;
+	job.count = count;
+	job.color = pack_color(color);
+	job.faint = pack_color(faint);
+
+	// missing glyphs are on their way to the workers and show up in a
+	// later frame. without workers they are rasterized right away, which
+	// can repack the atlas and move the glyphs recorded before them; only
+	// then are the panels recorded again.
+	u64 start = sys_ticks();
+	u32 generation = state->layouts.generation;
+	for (i32 attempt = 0; attempt < LAYOUT_ATTEMPTS; ++attempt) {
+		record_panels(state, job);
+		if (state->layouts.generation == generation)
+			break;
+		generation = state->layouts.generation;
+	}
+	u64 recorded = sys_ticks();
+
+	render_batch& batch = state->batch;
+	for (i32 i = 0; i < count; ++i) {
+		panel& p = panels[i];
+		panel_recorder& r = v.recorders[p.recorder];
+		const quad *quads = (const quad *)r.quads.memory;
+		const draw_command *commands = (const draw_command *)r.commands.memory + p.first_command;
+
+		for (i32 k = 0; k < p.command_count; ++k) {
+			const draw_command& d = commands[k];
+			const quad *src = quads + d.first;
+
+			for (i32 left = d.count; left > 0;) {
+				i32 n = min(left, batch.region_limit);
+				use_pipeline(batch, d.program, d.texture, d.blend);
+				copy_bytes(push_quads(state, n), src, sizeof(quad) * (size_t)n);
+				src += n;
+				left -= n;
+			}
+		}
+	}
+
+	v.threads = 0;
+	for (i32 i = 0; i <= state->workers.count; ++i) {
+		if (v.recorders[i].panels > 0)
+			++v.threads;
+		state->utf8_errors += v.recorders[i].utf8_errors;
+	}
+	v.record_ticks = recorded - start;
+	v.merge_ticks = sys_ticks() - recorded;
+}
+
+////////
+//
+// file view. a file is mapped rather than read, and only the lines in view
+// are ever looked at to draw it, found by scanning for newlines from the
+// line at the top. so the first frame costs the same for any size of file.
+// line numbers come from an index of where every FILE_INDEX_STRIDE-th line
+// starts, built a chunk at a time by a job in the background. the view
+// follows the end of the file as it grows, until it is scrolled back.
+
+internal void
+init_file_view(file_view& v)
+{
+	init_arena(v.index_arena, "file index", FILE_INDEX_RESERVE);
+	v.checkpoints = (u64 *)v.index_arena.memory;
+}
+
+internal void
+reset_file_index(file_view& v)
+{
+	reset_arena(v.index_arena);
+	v.checkpoint_count = 0;
+	v.line_count = 0;
+	v.indexed = 0;
+	v.index_ticks = 0;
+}
+
+// indexes the next chunk of the file up to end. the counts are published
+// for the render thread after the checkpoints they cover.
+internal void
+index_file_chunk(file_view& v, u64 end)
+{
+	u64 start = v.indexed;
+	u64 n = min(end - start, FILE_INDEX_CHUNK);
+
+	newline_counter c = { v.line_count, FILE_INDEX_STRIDE, v.checkpoints, v.checkpoint_count };
+	set_arena_end(v.index_arena, (size_t)(c.checkpoint_count + n / FILE_INDEX_STRIDE + 1) * sizeof(u64));
+	count_newlines(c, v.file.data + start, n, start);
+
+	atomic_store(&v.checkpoint_count, c.checkpoint_count);
+	atomic_store(&v.line_count, c.lines);
+	atomic_store(&v.indexed, start + n);
+}
+
+internal void
+index_file_job(i32 worker, void *data)
+{
+	unused(worker);
+	profile_function();
+
+	file_view& v = *(file_view *)data;
+
+	u64 start = sys_ticks();
+	while (v.indexed < v.index_end)
+		index_file_chunk(v, v.index_end);
+	v.index_ticks += sys_ticks() - start;
+
+	atomic_store(&v.indexing, 0);
+}
+
+// picks up growth of the file and keeps the index going. the file may move
+// when it is mapped again, so that only happens while no job is reading it.
+// without worker threads a chunk is indexed per frame instead.
+internal void
+update_file_view(app_state *state)
+{
+	profile_function();
+
+	file_view& v = state->file;
+	if (!v.file.sys || atomic_load(&v.indexing))
+		return;
+
+	if (sys_update_file(&v.file) && v.file.size < v.indexed) {
+		// the file was truncated or replaced.
+		reset_file_index(v);
+		v.top = 0;
+		v.follow = true;
+	}
+
+	if (v.indexed == v.file.size)
+		return;
+
+	v.index_end = v.file.size;
+	if (state->workers.count > 0) {
+		v.indexing = 1;
+		sys_add_work(index_file_job, &v);
+	}
+	else {
+		u64 start = sys_ticks();
+		index_file_chunk(v, v.index_end);
+		v.index_ticks += sys_ticks() - start;
+	}
+}
+
+// number of the line starting at offset at, or -1 if the index does not
+// reach that far yet.
+internal i64
+file_line_number(file_view& v, u64 at)
+{
+	if (at > atomic_load(&v.indexed))
+		return -1;
+
+	// the last checkpoint at or before at. line 0 starts at 0.
+	u64 lo = 0;
+	u64 hi = atomic_load(&v.checkpoint_count);
+	while (lo < hi) {
+		u64 mid = lo + (hi - lo) / 2;
+		if (v.checkpoints[mid] <= at)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	u64 start = lo ? v.checkpoints[lo - 1] : 0;
+	newline_counter c = { lo * FILE_INDEX_STRIDE, ~0ull, 0, 0 };
+	count_newlines(c, v.file.data + start, at - start, start);
+	return (i64)c.lines;
+}
+
+// start of the line before the one starting at at, which must not be 0.
+internal inline u64
+previous_line(const u8 *data, u64 at)
+{
+	return find_last_newline(data, at - 1);
+}
+
+internal void
+draw_file_view(app_state *state, file_view& v, rect2d view, vec4 color)
+{
+	profile_function();
+
+	struct font *font = state->console_font;
+	f32 height = line_height(font);
+
+	const u8 *data = v.file.data;
+
+	// a final newline does not start another line.
+	u64 end = v.file.size;
+	if (end && data[end - 1] == '\n')
+		--end;
+
+	i64 rows = max((i64)((view.y1 - view.y0) / height), (i64)1);
+
+	u64 tail = find_last_newline(data, end);
+	for (i64 i = 1; i < rows && tail; ++i)
+		tail = previous_line(data, tail);
+
+	for (; v.scroll > 0 && v.top; --v.scroll) {
+		v.top = previous_line(data, v.top);
+		v.follow = false;
+	}
+	for (; v.scroll < 0 && v.top < tail; ++v.scroll)
+		v.top += find_newline(data + v.top, end - v.top) + 1;
+	v.scroll = 0;
+
+	if (v.follow || v.top >= tail) {
+		v.top = tail;
+		v.follow = true;
+	}
+
+	// line numbers go in a gutter on the left.
+	char number[16];
+	f32 gutter = 10.f * (f32)font->average_width;
+	vec4 dim = { color.r * .5f, color.g * .5f, color.b * .5f, color.a * .5f };
+	i32 columns = (i32)((view.x1 - view.x0 - gutter) / (f32)font->average_width);
+
+	i64 line = file_line_number(v, v.top);
+
+	vec2 cursor = { view.x0, view.y1 - height };
+	u64 at = v.top;
+	for (i64 row = 0; row < rows && at <= end; ++row) {
+		u64 n = find_newline(data + at, end - at);
+
+		const char *s = (const char *)data + at;
+		size_t length = (size_t)n;
+		if (length && s[length - 1] == '\r')
+			--length;
+
+		if (line >= 0) {
+			fmt(number, number + sizeof(number), "%8d", (i32)(line + row + 1));
+			draw_text(state, font, number, cursor, dim);
+		}
+
+		vec2 text = { cursor.x + gutter, cursor.y };
+		draw_line(state, font, s, length, columns, text, color);
+
+		cursor.y -= height;
+		at += n + 1;
+	}
+
+	if (!v.first_frame_ticks)
+		v.first_frame_ticks = sys_ticks() - v.open_ticks;
+}
+
+#if PROFILER
+
+internal void
+reset_profile_view(profile_view& v)
+{
+	for (i32 t = 0; t <= MAX_WORKER_THREADS; ++t) {
+		v.read[t] = atomic_load(&global_profiler->rings[t].write);
+		v.depth[t] = 0;
+	}
+
+	v.zone_count = 0;
+	v.shown_count = 0;
+	v.frames = 0;
+}
+
+internal void
+add_zone_time(profile_view& v, const char *name, u64 ticks)
+{
+	i32 i = 0;
+	while (i < v.zone_count && v.zones[i].name != name)
+		++i;
+
+	if (i == v.zone_count) {
+		if (v.zone_count == PROFILE_MAX_ZONES)
+			return;
+		v.zones[v.zone_count++] = { name, 0, 0, 0 };
+	}
+
+	v.zones[i].ticks += ticks;
+	++v.zones[i].count;
+}
+
+// matches the begin and end events recorded since the last call. zones
+// still open carry over to the next frame.
+internal void
+read_profile_events(profile_view& v)
+{
+	for (i32 t = 0; t <= MAX_WORKER_THREADS; ++t) {
+		profile_ring& r = global_profiler->rings[t];
+		u32 write = atomic_load(&r.write);
+
+		// the ring wrapped around since the last read.
+		u32 first = profile_first_event(r, write);
+		if ((i32)(v.read[t] - first) < 0) {
+			v.read[t] = first;
+			v.depth[t] = 0;
+		}
+
+		i32& depth = v.depth[t];
+		profile_event *open = v.open[t];
+		for (u32 i = v.read[t]; i != write; ++i) {
+			const profile_event& e = r.events[i & (PROFILE_RING_SIZE - 1)];
+			if (e.name) {
+				if (depth < PROFILE_MAX_DEPTH)
+					open[depth] = e;
+				++depth;
+			}
+			else if (depth > 0) {
+				--depth;
+				if (depth < PROFILE_MAX_DEPTH)
+					add_zone_time(v, open[depth].name, e.ticks - open[depth].ticks);
+			}
+		}
+
+		v.read[t] = write;
+	}
+
+	if (++v.frames == PROFILE_WINDOW) {
+		copy_n(v.zone_count, v.shown, v.zones);
+		v.shown_count = v.zone_count;
+		insertion_sort(v.shown, v.shown + v.shown_count, [](const zone_stats& a, const zone_stats& b) {
+			return a.ticks > b.ticks;
+		});
+
+		v.zone_count = 0;
+		v.frames = 0;
+	}
+}
+
+#endif
+
+internal void
+debug_text(app_state *state, const char *s)
+{
+	constexpr vec4 white_color = { 1.f, 1.f, 1.f, 1.f };
+
+	state->debug_cursor = draw_text(state, state->console_font, s, state->debug_cursor, white_color);
+}
+
+// current use and high water mark of an allocator.
+internal void
+debug_arena(app_state *state, const arena& a)
+{
+	char buf[64];
+	char *end = buf + sizeof(buf);
+
+	char *p = copy_string(buf, end, a.name);
+	p = fmt(p, end, ": %d KB", (i32)(a.used / 1024));
+	fmt(p, end, ", peak %d KB\n", (i32)(a.high_water / 1024));
+	debug_text(state, buf);
+}
+
+internal void
+debug_pool(app_state *state, const pool& a)
+{
+	char buf[64];
+	char *end = buf + sizeof(buf);
+
+	char *p = copy_string(buf, end, a.name);
+	p = fmt(p, end, ": %d", (i32)a.live);
+	fmt(p, end, ", peak %d\n", (i32)a.high_water);
+	debug_text(state, buf);
+}
+
+// the distance field font is rasterized once at this size and drawn at
+// SDF_MIN_SCALE to SDF_MAX_SCALE times it.
+#define SDF_FONT_SIZE	36
+#define SDF_SPREAD	6
+#define SDF_MIN_SCALE	.2f
+#define SDF_MAX_SCALE	4.f
+
+// bottom of the console view. the sample text is drawn below it.
+#define CONSOLE_VIEW_Y	120
+
+// a font rasterized from its truetype outlines. the metrics are rounded
+// like the platforms round them.
+internal font *
+create_truetype_font(app_state *state, ttf_font *t, const wchar_t *name, i32 pixel_height)
+{
+	allocator *from = &state->permanent_arena.base;
+	font *result = allocate<font>(from, 1, ALLOCATE_ZERO);
+	result->ttf = t;
+	result->pixel_height = pixel_height;
+
+	i32 len = 0;
+	while (name[len])
+		++len;
+	wchar_t *name_copy = allocate<wchar_t>(from, (size_t)len + 1);
+	copy_n(len + 1, name_copy, name);
+	result->name = name_copy;
+
+	f32 scale = truetype_scale(*t, pixel_height);
+	auto round_up = [](f32 x) { return -floor_i32(-x); };
+
+	result->ascent = round_up((f32)t->ascender * scale);
+	result->descent = round_up((f32)-t->descender * scale);
+	result->height = result->ascent + result->descent;
+	result->external_leading = max(round_up((f32)(t->ascender - t->descender + t->line_gap) * scale) - result->height, 0);
+	result->default_x = max(round_up((f32)t->advance_max * scale), 1);
+	result->default_y = result->height;
+	result->average_width = floor_i32((f32)glyph_advance(*t, glyph_index(*t, 'x')) * scale + .5f);
+
+	return result;
 }
 
-internal inline void
-draw_rect2d(app_state *state, rect2d position, f32 z, vec4 color)
+// loads a font from its file when it has truetype outlines, and through
+// the platform otherwise.
+internal font *
+load_font(app_state *state, const wchar_t *name, i32 pixel_height)
 {
-	clear(state->vertices);
-	mesh_rect2d(state->vertices, position.x0, position.y0, position.x1, position.y1, z, 0.f, 0.f, 0.f, 0.f, color);
+	assert(state->fonts.count < MAX_FONTS);
+
+	font *result = 0;
+
+	char path[1024];
+	i32 index = 0;
+	if (sys_find_font_file(name, path, sizeof(path), &index)) {
+		ttf_font *t = allocate<ttf_font>(&state->permanent_arena.base, 1, ALLOCATE_ZERO);
+		if (load_truetype(*t, path, index))
+			result = create_truetype_font(state, t, name, pixel_height);
+		else
+			deallocate(&state->permanent_arena.base, t, 1);
+	}
 
-	upload_vertices(state);
+	if (!result)
+		result = sys_create_font(name, pixel_height);
 
-	glUseProgram(state->basic_program);
-	glDrawArrays(GL_TRIANGLES, 0, state->vertices.count);
-	glUseProgram(0);
+	*allocate_n(state->fonts, 1) = result;
+	return result;
 }
 
+// rasterizes the printable ascii range of every font, one job per font.
 internal void
-debug_text(app_state *state, const char *s)
+warm_glyph_cache(app_state *state)
 {
-	constexpr f32 z = 0.f;
-	constexpr vec4 white_color = { 1.f, 1.f, 1.f, 1.f };
+	profile_function();
+
+	for (font *f : state->fonts) {
+		glyph_result *job = 0;
+		for (u32 codepoint = 126; codepoint >= ' '; --codepoint) {
+			glyph *g = find_glyph(f, codepoint);
+			if (!g)
+				g = add_glyph(f, codepoint);
+			if (g->page == GLYPH_UNLOADED)
+				job = request_glyph(state, f, g, job);
+		}
 
-	state->debug_cursor = draw_text(state, state->console_font, s, state->debug_cursor, z, white_color);
+		if (job)
+			sys_add_work(rasterize_glyph_job, job);
+	}
+
+	sys_complete_work();
+	receive_glyphs(state);
 }
 
-API_EXPORT void *
-reload(void *userdata)
+////////
+//
+// glyph cache file. when starting up rasterized anything, the atlases and
+// the glyph tables of the fonts are written to GLYPH_CACHE_FILE, and the
+// next start maps it and takes them over before warming the glyph cache,
+// which then only rasterizes what the file lacks. a font takes over the
+// glyphs of the font in the file with the same name, size, spread, dpi and
+// rasterizer, if the metrics agree too, in case the font file changed.
+//
+// the structs are written as they are, so the file only moves between
+// builds that hash them to the same GLYPH_CACHE_LAYOUT.
+
+#define GLYPH_CACHE_FILE	"glyph_cache.bin"
+// how often glyphs rasterized while running are added to it.
+#define GLYPH_CACHE_SAVE_MS	5000
+// "glch"
+#define GLYPH_CACHE_MAGIC	0x68636C67
+#define GLYPH_CACHE_VERSION	2
+// every record starts on a multiple of it, so the mapped file can be read
+// in place.
+#define GLYPH_CACHE_ALIGN	8
+
+struct glyph_cache_header
+{
+	u32 magic;
+	u32 version;
+	u64 layout;
+
+	// of the coverage atlas and of the distance field atlas.
+	i32 page_counts[2];
+	i32 font_count;
+	u32 pad;
+};
+
+// followed by skyline_count nodes and size * size bytes of the page.
+struct glyph_cache_page
+{
+	i32 size;
+	i32 skyline_count;
+	i64 used;
+};
+
+// followed by glyph_count glyphs.
+struct glyph_cache_font
+{
+	u64 name_hash;
+	i32 pixel_height;
+	i32 sdf_spread;
+	i32 dpi;
+	u32 truetype;
+
+	i32 ascent;
+	i32 descent;
+	i32 height;
+	i32 average_width;
+
+	i32 glyph_count;
+	u32 pad;
+};
+
+static constexpr u64 GLYPH_CACHE_LAYOUT = layout_hash({
+	GLYPH_CACHE_VERSION, sizeof(glyph_cache_header), sizeof(glyph_cache_page),
+	sizeof(glyph_cache_font), sizeof(skyline_node), sizeof(glyph),
+});
+
+internal glyph_cache_font
+glyph_cache_key(const struct font *font)
+{
+	size_t n = 0;
+	while (font->name[n])
+		++n;
+
+	glyph_cache_font key = {};
+	key.name_hash = hash_bytes(font->name, n * sizeof(wchar_t));
+	key.pixel_height = font->pixel_height;
+	key.sdf_spread = font->sdf_spread;
+	key.dpi = FONT_DPI;
+	key.truetype = font->ttf != 0;
+	key.ascent = font->ascent;
+	key.descent = font->descent;
+	key.height = font->height;
+	key.average_width = font->average_width;
+	key.glyph_count = font->glyphs.count;
+	return key;
+}
+
+internal inline bool
+same_font(const glyph_cache_font& a, const glyph_cache_font& b)
+{
+	return a.name_hash == b.name_hash && a.pixel_height == b.pixel_height && a.sdf_spread == b.sdf_spread &&
+		a.dpi == b.dpi && a.truetype == b.truetype && a.ascent == b.ascent && a.descent == b.descent &&
+		a.height == b.height && a.average_width == b.average_width;
+}
+
+// whether nodes form a skyline across a page of the given size, which is
+// what skyline_find and skyline_insert expect.
+internal bool
+valid_skyline(const skyline_node *nodes, i32 count, i32 size)
+{
+	i32 x = 0;
+	for (i32 i = 0; i < count; ++i) {
+		const skyline_node& n = nodes[i];
+		if (n.x != x || n.width <= 0 || n.width > size - x || n.y < 0 || n.y > size)
+			return false;
+		x += n.width;
+	}
+	return x == size;
+}
+
+// bytes a record of n bytes takes up in the file.
+internal inline size_t
+record_size(size_t n)
+{
+	return (n + GLYPH_CACHE_ALIGN - 1) / GLYPH_CACHE_ALIGN * GLYPH_CACHE_ALIGN;
+}
+
+internal inline u8 *
+write_bytes(u8 *at, const void *p, size_t n)
+{
+	copy_n(n, at, (const u8 *)p);
+	return fill_n(record_size(n) - n, at + n, (u8)0);
+}
+
+// takes a record of n bytes from the file, or returns 0 if it ends before
+// or the record is misaligned.
+internal inline const u8 *
+read_bytes(const u8 *&at, const u8 *end, size_t n)
+{
+	if ((uintptr_t)at % GLYPH_CACHE_ALIGN != 0 || (size_t)(end - at) < record_size(n))
+		return 0;
+	const u8 *result = at;
+	at += record_size(n);
+	return result;
+}
+
+internal bool
+save_glyph_cache(app_state *state)
+{
+	profile_function();
+
+	glyph_atlas *atlases[] = { &state->atlas, &state->sdf_atlas };
+
+	size_t size = record_size(sizeof(glyph_cache_header));
+	for (glyph_atlas *atlas : atlases) {
+		for (i32 i = 0; i < atlas->page_count; ++i) {
+			const atlas_page& page = atlas->pages[i];
+			size += record_size(sizeof(glyph_cache_page)) + record_size((size_t)page.skyline.count * sizeof(skyline_node));
+			size += record_size((size_t)page.size * (size_t)page.size);
+		}
+	}
+	for (font *f : state->fonts)
+		size += record_size(sizeof(glyph_cache_font)) + record_size((size_t)f->glyphs.count * sizeof(glyph));
+
+	u8 *buf = (u8 *)push_arena(state->frame_arena, size, GLYPH_CACHE_ALIGN, 0);
+	u8 *at = buf;
+
+	glyph_cache_header h = {};
+	h.magic = GLYPH_CACHE_MAGIC;
+	h.version = GLYPH_CACHE_VERSION;
+	h.layout = GLYPH_CACHE_LAYOUT;
+	h.page_counts[0] = state->atlas.page_count;
+	h.page_counts[1] = state->sdf_atlas.page_count;
+	h.font_count = state->fonts.count;
+	at = write_bytes(at, &h, sizeof(h));
+
+	for (glyph_atlas *atlas : atlases) {
+		for (i32 i = 0; i < atlas->page_count; ++i) {
+			const atlas_page& page = atlas->pages[i];
+
+			glyph_cache_page p = {};
+			p.size = page.size;
+			p.skyline_count = page.skyline.count;
+			p.used = page.used;
+			at = write_bytes(at, &p, sizeof(p));
+			at = write_bytes(at, page.skyline.data, (size_t)page.skyline.count * sizeof(skyline_node));
+			at = write_bytes(at, page.bits, (size_t)page.size * (size_t)page.size);
+		}
+	}
+
+	for (font *f : state->fonts) {
+		glyph_cache_font key = glyph_cache_key(f);
+		at = write_bytes(at, &key, sizeof(key));
+		at = write_bytes(at, f->glyphs.data, (size_t)f->glyphs.count * sizeof(glyph));
+	}
+	assert(at == buf + size);
+
+	bool ok = sys_write_file(GLYPH_CACHE_FILE, buf, size, false);
+	deallocate(&state->frame_arena.base, buf, size);
+
+	state->cache_saved = sys_ticks();
+	state->cache_rasterized = state->atlas.rasterized + state->sdf_atlas.rasterized;
+	return ok;
+}
+
+// the first pass checks the whole file, the second replaces the atlas
+// pages with the ones in it and fills the glyph tables of the fonts that
+// match. returns the number of fonts that took over glyphs.
+internal i32
+load_glyph_cache(app_state *state)
+{
+	profile_function();
+
+	mapped_file file = {};
+	if (!sys_map_file(GLYPH_CACHE_FILE, &file))
+		return 0;
+
+	glyph_atlas *atlases[] = { &state->atlas, &state->sdf_atlas };
+	i32 page_sizes[2][ATLAS_MAX_PAGES];
+
+	// pass 0 only checks the file, down to every skyline node and glyph
+	// rectangle, which pack_rect and repack_atlas index the pages with.
+	// pass 1 takes it over.
+	i32 matched = 0;
+	for (i32 pass = 0; pass < 2; ++pass) {
+		const u8 *at = file.data;
+		const u8 *end = file.data + file.size;
+
+		const glyph_cache_header *h = (const glyph_cache_header *)read_bytes(at, end, sizeof(glyph_cache_header));
+		if (!h || h->magic != GLYPH_CACHE_MAGIC || h->version != GLYPH_CACHE_VERSION || h->layout != GLYPH_CACHE_LAYOUT)
+			break;
+
+		bool ok = true;
+		for (i32 a = 0; ok && a < 2; ++a) {
+			glyph_atlas& atlas = *atlases[a];
+			ok = h->page_counts[a] >= 1 && h->page_counts[a] <= atlas.max_pages;
+
+			for (i32 i = 0; ok && i < h->page_counts[a]; ++i) {
+				const glyph_cache_page *p = (const glyph_cache_page *)read_bytes(at, end, sizeof(glyph_cache_page));
+				ok = p && p->size >= atlas.min_size && p->size <= atlas.max_size &&
+					p->skyline_count >= 1 && p->skyline_count <= p->size;
+				const u8 *nodes = ok ? read_bytes(at, end, (size_t)p->skyline_count * sizeof(skyline_node)) : 0;
+				const u8 *bits = nodes ? read_bytes(at, end, (size_t)p->size * (size_t)p->size) : 0;
+				ok = bits && valid_skyline((const skyline_node *)nodes, p->skyline_count, p->size);
+
+				if (!ok || pass == 0) {
+					if (ok)
+						page_sizes[a][i] = p->size;
+					continue;
+				}
+
+				if (i == atlas.page_count)
+					add_page(atlas);
+
+				atlas_page& page = atlas.pages[i];
+				if (page.size != p->size) {
+					sys_deallocate(page.bits, (size_t)page.size * (size_t)page.size, alignof(u8));
+					page.size = p->size;
+					page.bits = allocate<u8>((size_t)page.size * (size_t)page.size);
+				}
+				copy_n((size_t)page.size * (size_t)page.size, page.bits, bits);
+				clear(page.skyline);
+				copy_n(p->skyline_count, allocate_n(page.skyline, p->skyline_count), (const skyline_node *)nodes);
+				page.used = p->used;
+
+				// straight from the file into the texture.
+				create_page_texture(atlas, page);
+				glBindTexture(GL_TEXTURE_2D, page.texture);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, page.size, page.size, GL_RED, GL_UNSIGNED_BYTE, bits);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				page.dirty = {};
+			}
+		}
+
+		for (i32 i = 0; ok && i < h->font_count; ++i) {
+			const glyph_cache_font *key = (const glyph_cache_font *)read_bytes(at, end, sizeof(glyph_cache_font));
+			const glyph *glyphs = key ? (const glyph *)read_bytes(at, end, (size_t)max(key->glyph_count, 0) * sizeof(glyph)) : 0;
+			ok = glyphs != 0 || (key && key->glyph_count == 0);
+
+			i32 a = key && key->sdf_spread ? 1 : 0;
+			for (i32 j = 0; ok && pass == 0 && j < key->glyph_count; ++j) {
+				const glyph& g = glyphs[j];
+				if (g.page >= 0 && g.page < h->page_counts[a]) {
+					i32 size = page_sizes[a][g.page];
+					ok = g.x0 >= 0 && g.x0 <= g.x1 && g.x1 <= size && g.y0 >= 0 && g.y0 <= g.y1 && g.y1 <= size;
+				}
+			}
+
+			if (!ok || pass == 0)
+				continue;
+
+			for (font *f : state->fonts) {
+				if (f->glyphs.count || !same_font(glyph_cache_key(f), *key))
+					continue;
+
+				i32 page_count = h->page_counts[a];
+				for (i32 j = 0; j < key->glyph_count; ++j) {
+					glyph *g = find_glyph(f, glyphs[j].codepoint);
+					if (!g)
+						g = add_glyph(f, glyphs[j].codepoint);
+
+					u32 id = g->id;
+					*g = glyphs[j];
+					g->id = id;
+					g->last_used = 0;
+					if (g->page < 0 || g->page >= page_count)
+						g->page = GLYPH_UNLOADED;
+				}
+				++matched;
+				break;
+			}
+		}
+
+		if (!ok)
+			break;
+	}
+
+	sys_unmap_file(&file);
+	return matched;
+}
+
+////////
+//
+// gpu objects. they are all created again when a reload changes the state
+// layout, and the programs when the shader sources change.
+
+static const char texture_vs_src[] = R"(#version 330
+
+	layout(location = 0) in vec4 vs_rect;
+	layout(location = 1) in vec4 vs_texrect;
+	layout(location = 2) in vec4 vs_color;
+
+	out vec2 fs_texcoord;
+	out vec4 fs_color;
+
+	uniform mat4 proj;
+	uniform sampler2D texture_map;
+
+	void main(void)
+	{
+		vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+		vec2 position = mix(vs_rect.xy, vs_rect.zw, corner);
+		vec2 texel = mix(vs_texrect.xy, vs_texrect.zw, corner);
+
+		fs_texcoord = texel / vec2(textureSize(texture_map, 0));
+		fs_color = vs_color;
+		gl_Position = proj * vec4(position, 0, 1);
+	}
+)";
+
+static const char texture_fs_src[] = R"(#version 330
+
+	in vec2 fs_texcoord;
+	in vec4 fs_color;
+
+	out vec4 frag_color;
+
+	uniform sampler2D texture_map;
+
+	void main(void)
+	{
+		// the atlas holds linear coverage. the color channels get the
+		// sRGB decode that sampling an sRGB texture would apply.
+		float c = texture(texture_map, fs_texcoord).r;
+		vec3 rgb = mix(vec3(c / 12.92), vec3(pow((c + 0.055) / 1.055, 2.4)), bvec3(c > 0.04045));
+		frag_color = vec4(rgb, c) * fs_color;
+	}
+)";
+
+static const char sdf_fs_src[] = R"(#version 330
+
+	in vec2 fs_texcoord;
+	in vec4 fs_color;
+
+	out vec4 frag_color;
+
+	uniform sampler2D texture_map;
+
+	void main(void)
+	{
+		// the field crosses 0.5 on the outline. how much it changes
+		// from one pixel to the next sets the width of the edge, so
+		// edges stay one pixel wide at any scale.
+		float d = texture(texture_map, fs_texcoord).r - 0.5;
+		float w = max(length(vec2(dFdx(d), dFdy(d))), 1.0 / 4096.0);
+		float c = clamp(d / w + 0.5, 0.0, 1.0);
+		vec3 rgb = mix(vec3(c / 12.92), vec3(pow((c + 0.055) / 1.055, 2.4)), bvec3(c > 0.04045));
+		frag_color = vec4(rgb, c) * fs_color;
+	}
+)";
+
+internal u64
+shader_hash(void)
+{
+	u64 h = hash_bytes(texture_vs_src, sizeof(texture_vs_src));
+	h ^= hash_bytes(texture_fs_src, sizeof(texture_fs_src)) * 3;
+	h ^= hash_bytes(sdf_fs_src, sizeof(sdf_fs_src)) * 5;
+	return h;
+}
+
+internal void
+create_programs(app_state *state)
 {
-	if (userdata)
-		return userdata;
+	state->texture_program = opengl_program(texture_vs_src, texture_fs_src);
+	state->texture_uproj = opengl_uniform_location(state->texture_program, "proj");
+	state->texture_umap = opengl_uniform_location(state->texture_program, "texture_map");
+
+	state->sdf_program = opengl_program(texture_vs_src, sdf_fs_src);
+	state->sdf_uproj = opengl_uniform_location(state->sdf_program, "proj");
+	state->sdf_umap = opengl_uniform_location(state->sdf_program, "texture_map");
+
+	state->shader_hash = shader_hash();
+}
 
-	app_state *state = allocate<app_state>(1);
+internal void
+delete_programs(app_state *state)
+{
+	glDeleteProgram(state->texture_program);
+	glDeleteProgram(state->sdf_program);
+	state->texture_program = 0;
+	state->sdf_program = 0;
+}
 
+// everything but the atlas pages, whose textures come and go with them.
+internal void
+create_gpu_objects(app_state *state)
+{
 	glGenVertexArrays(1, &state->vao);
 	glBindVertexArray(state->vao);
 
-	glGenBuffers(1, &state->vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
+	state->batch.region_limit = 1024 * 64;
+
+	glGenBuffers(1, &state->batch.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, state->batch.vbo);
+	glBufferData(GL_ARRAY_BUFFER, (ptrdiff_t)sizeof(quad) * state->batch.region_limit * STREAM_REGIONS, 0, GL_STREAM_DRAW);
 
 	glEnableVertexAttribArray(0);
 	glEnableVertexAttribArray(1);
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(vertex), (void *)offsetof(vertex, position));
-	glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(vertex), (void *)offsetof(vertex, texcoord));
-	glVertexAttribPointer(2, 4, GL_FLOAT, false, sizeof(vertex), (void *)offsetof(vertex, color));
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribDivisor(2, 1);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	const char *basic_vs_src = R"(#version 330
+	create_programs(state);
 
-		layout(location = 0) in vec3 vs_position;
-		layout(location = 1) in vec2 vs_texcoord;
-		layout(location = 2) in vec4 vs_color;
+#if ATLAS_UPLOAD_PBO
+	glGenBuffers(1, &state->atlas.pbo);
+	state->sdf_atlas.pbo = state->atlas.pbo;
+#endif
 
-		out vec4 fs_color;
+	glEnable(GL_FRAMEBUFFER_SRGB);
 
-		uniform mat4 proj;
+	init_gpu_timer(state->gpu);
+}
 
-		void main(void)
-		{
-			fs_color = vs_color;
-			gl_Position = proj * vec4(vs_position, 1);
+internal void
+delete_gpu_objects(app_state *state)
+{
+	for (gpu_frame& f : state->gpu.frames)
+		glDeleteQueries(GPU_MAX_PASSES + 1, f.queries);
+
+	render_batch& batch = state->batch;
+	for (void *&fence : batch.fences) {
+		if (fence)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+	glDeleteBuffers(1, &batch.vbo);
+	batch.vbo = 0;
+
+	glyph_atlas *atlases[] = { &state->atlas, &state->sdf_atlas };
+	for (glyph_atlas *atlas : atlases) {
+		for (i32 i = 0; i < atlas->page_count; ++i) {
+			glDeleteTextures(1, &atlas->pages[i].texture);
+			atlas->pages[i].texture = 0;
 		}
-	)";
+	}
+	glDeleteBuffers(1, &state->atlas.pbo);
+	state->atlas.pbo = 0;
+	state->sdf_atlas.pbo = 0;
+
+	delete_programs(state);
+
+	glDeleteVertexArrays(1, &state->vao);
+	state->vao = 0;
+}
+
+// takes over what the old code carried across a change of the state
+// layout. the atlas pages get new textures, which the next frame fills
+// from their bits.
+internal void
+adopt_carried_state(app_state *state, carried_state *c)
+{
+	state->atlas = c->atlas;
+	state->sdf_atlas = c->sdf_atlas;
+	glyph_atlas *atlases[] = { &state->atlas, &state->sdf_atlas };
+	for (glyph_atlas *atlas : atlases)
+		for (i32 i = 0; i < atlas->page_count; ++i)
+			create_page_texture(*atlas, atlas->pages[i]);
+
+	state->console = c->console;
+	state->file = c->file;
+
+	for (i32 i = 0; i < c->font_count; ++i) {
+		*allocate_n(state->fonts, 1) = c->fonts[i];
+		for (i32 j = 0; j <= MAX_WORKER_THREADS; ++j)
+			state->workers.fonts[i][j] = c->worker_fonts[i][j];
+	}
+	state->console_font = c->fonts[c->console_font];
+	state->ui_font = c->fonts[c->ui_font];
+	state->sdf_font = c->fonts[c->sdf_font];
+	state->sdf_scale = c->sdf_scale;
+}
 
-	const char *basic_fs_src = R"(#version 330
+// frees what app_state keeps on the heap. the fonts and the atlases are
+// carried, and the panel recorders and the frame arena are released
+// before.
+internal void
+release_heap_arrays(app_state *state)
+{
+	release(state->batch.commands);
+
+	for (i32 i = 0; i <= MAX_WORKER_THREADS + 1; ++i) {
+		glyph_outline& o = i <= MAX_WORKER_THREADS ? state->workers.outlines[i] : state->outline;
+		release(o.lines);
+		release(o.points);
+		release(o.on_curve);
+		release(o.area);
+	}
 
-		in vec4 fs_color;
+	layout_cache& c = state->layouts;
+	for (i32 i = 0; i <= LAYOUT_CACHE_SIZE; ++i) {
+		text_layout& l = i < LAYOUT_CACHE_SIZE ? c.slots[i] : c.scratch;
+		release(l.quads);
+		release(l.glyphs);
+		release(l.runs);
+	}
+	release(c.map);
+}
 
-		out vec4 frag_color;
+API_EXPORT u64
+state_layout(void)
+{
+	return STATE_LAYOUT;
+}
 
-		void main(void)
-		{
-			frag_color = fs_color;
+API_EXPORT void *
+migrate(void *userdata, u64 layout)
+{
+	app_state *state = (app_state *)userdata;
+	if (layout == STATE_LAYOUT)
+		return state;
+
+	profile_function();
+
+	// glyphs in flight land in the atlas before it is packed.
+	sys_complete_work();
+	receive_glyphs(state);
+	while (atomic_load(&state->file.indexing))
+		sys_complete_work();
+
+	flush_gpu_log(state->gpu);
+	delete_gpu_objects(state);
+	release_arena(state->frame_arena);
+	for (panel_recorder& r : state->panels.recorders) {
+		if (r.quads.memory) {
+			release_arena(r.quads);
+			release_arena(r.commands);
+			release_arena(r.misses);
 		}
-	)";
-	state->basic_program = opengl_program(basic_vs_src, basic_fs_src);
-	state->basic_uproj = opengl_uniform_location(state->basic_program, "proj");
+	}
 
-	const char *texture_vs_src = R"(#version 330
+	carried_state *c = allocate<carried_state>(&state->permanent_arena.base, 1, ALLOCATE_ZERO);
+	c->tag = CARRIED_STATE_TAG;
+	c->layout = CARRIED_LAYOUT;
+	c->atlas = state->atlas;
+	c->sdf_atlas = state->sdf_atlas;
+	c->console = state->console;
+	c->file = state->file;
+
+	for (font *f : state->fonts) {
+		i32 i = c->font_count++;
+		c->fonts[i] = f;
+		for (i32 j = 0; j <= MAX_WORKER_THREADS; ++j)
+			c->worker_fonts[i][j] = state->workers.fonts[i][j];
+		if (f == state->console_font) c->console_font = i;
+		if (f == state->ui_font) c->ui_font = i;
+		if (f == state->sdf_font) c->sdf_font = i;
+	}
+	c->sdf_scale = state->sdf_scale;
 
-		layout(location = 0) in vec3 vs_position;
-		layout(location = 1) in vec2 vs_texcoord;
-		layout(location = 2) in vec4 vs_color;
+	// after the last allocation from it.
+	c->permanent_arena = state->permanent_arena;
 
-		out vec2 fs_texcoord;
-		out vec4 fs_color;
+	// app_state is gone after this.
+	release_heap_arrays(state);
+	arena state_arena = state->state_arena;
+	release_arena(state_arena);
 
-		uniform mat4 proj;
+	return c;
+}
 
-		void main(void)
-		{
-			fs_texcoord = vs_texcoord;
-			fs_color = vs_color;
-			gl_Position = proj * vec4(vs_position, 1);
+// userdata is 0 on the first load. otherwise it is the app_state of the
+// old code if that lays it out the same way, or what its migrate carried.
+API_EXPORT void *
+reload(void *userdata)
+{
+#if PROFILER
+	global_profiler = sys_profiler();
+#endif
+
+	if (userdata && ((app_state *)userdata)->layout == STATE_LAYOUT) {
+		app_state *state = (app_state *)userdata;
+#if PROFILER
+		// the zone names of the old code are gone.
+		reset_profile_view(state->profile);
+#endif
+		reset_gpu_timer(state->gpu);
+
+		if (state->shader_hash != shader_hash()) {
+			delete_programs(state);
+			create_programs(state);
 		}
-	)";
+		return state;
+	}
 
-	const char *texture_fs_src = R"(#version 330
+	// anything else, such as the state of code from before versioning, is
+	// left behind.
+	carried_state *carried = (carried_state *)userdata;
+	if (carried && (carried->tag != CARRIED_STATE_TAG || carried->layout != CARRIED_LAYOUT))
+		carried = 0;
 
-		in vec2 fs_texcoord;
-		in vec4 fs_color;
+	arena permanent = {};
+	if (carried)
+		permanent = carried->permanent_arena;
+	else
+		init_arena(permanent, "permanent arena", PERMANENT_ARENA_SIZE);
 
-		out vec4 frag_color;
+	arena state_arena = {};
+	init_arena(state_arena, "state arena", STATE_ARENA_SIZE);
 
-		uniform sampler2D texture_map;
+	app_state *state = allocate<app_state>(&state_arena.base, 1, ALLOCATE_ZERO);
+	state->layout = STATE_LAYOUT;
+	state->permanent_arena = permanent;
+	state->state_arena = state_arena;
 
-		void main(void)
-		{
-			frag_color = texture(texture_map, fs_texcoord) * fs_color;
-		}
-	)";
-	state->texture_program = opengl_program(texture_vs_src, texture_fs_src);
-	state->texture_uproj = opengl_uniform_location(state->texture_program, "proj");
-	state->texture_umap = opengl_uniform_location(state->texture_program, "texture_map");
+	init_arena(state->frame_arena, "frame arena", FRAME_ARENA_SIZE);
+	init_pool(state->results, "glyph results", sizeof(glyph_result), &state->state_arena.base);
+	state->tick_frequency = sys_tick_frequency();
+	state->frame_start = sys_ticks();
 
-	state->atlas_width = 512;
-	state->atlas_height = 512;
-	state->atlas_bits = allocate<u32>((size_t)(state->atlas_width * state->atlas_height));
+#if PROFILER
+	reset_profile_view(state->profile);
+#endif
 
-	glGenTextures(1, &state->atlas);
-	glBindTexture(GL_TEXTURE_2D, state->atlas);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, state->atlas_width, state->atlas_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, state->atlas_bits);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	init(state->workers.results);
+	state->workers.count = min(sys_worker_count(), MAX_WORKER_THREADS);
 
-	glEnable(GL_FRAMEBUFFER_SRGB);
+	reserve(state->batch.commands, 256);
 
-	reserve(state->vertices, 1024 * 64);
+	state->fonts.from = &state->state_arena.base;
+	reserve(state->fonts, MAX_FONTS);
 
-	// load assets
-	state->console_font = sys_create_font(L"Courier New", 10);
-	state->ui_font = sys_create_font(L"Verdana", 8);
+	init_layout_cache(state->layouts);
 
-	for (u32 codepoint = ' '; codepoint < 127; ++codepoint) {
-		render_glyph(state, state->console_font, codepoint);
-		render_glyph(state, state->ui_font, codepoint);
+	if (carried) {
+		adopt_carried_state(state, carried);
+		// the last allocation from the permanent arena, so the next
+		// migrate reuses its memory.
+		deallocate(&state->permanent_arena.base, carried, 1);
+		create_gpu_objects(state);
+		return state;
 	}
 
+	glyph_atlas& atlas = state->atlas;
+	atlas.min_size = 512;
+	atlas.max_size = 2048;
+	atlas.max_pages = ATLAS_MAX_PAGES;
+	atlas.evict_age = 600;
+	atlas.filter = GL_NEAREST;
+	add_page(atlas);
+	reserve_white_block(atlas);
+
+	// distance fields are only rasterized at one size, so they need far
+	// less room.
+	glyph_atlas& sdf_atlas = state->sdf_atlas;
+	sdf_atlas.min_size = 512;
+	sdf_atlas.max_size = 1024;
+	sdf_atlas.max_pages = 2;
+	sdf_atlas.evict_age = 600;
+	sdf_atlas.filter = GL_LINEAR;
+	add_page(sdf_atlas);
+	reserve_white_block(sdf_atlas);
+
+	create_gpu_objects(state);
+
+	init_console(state->console);
+	init_file_view(state->file);
+	const char *hello = "ctrl+f appends a million lines, ctrl+t splits them into panels, the mouse wheel scrolls.\n";
+	append_console(state->console, hello, string_length(hello));
+
+	// load assets
+	state->console_font = load_font(state, L"Courier New", 10);
+	state->ui_font = load_font(state, L"Verdana", 8);
+
+	state->sdf_font = load_font(state, L"Verdana", SDF_FONT_SIZE);
+	state->sdf_font->sdf_spread = SDF_SPREAD;
+	state->sdf_scale = .4f;
+
+	state->cached_fonts = load_glyph_cache(state);
+	warm_glyph_cache(state);
+	if (state->atlas.rasterized + state->sdf_atlas.rasterized > 0)
+		save_glyph_cache(state);
+
 	return state;
 }
 
+// a notch of the mouse wheel is 120.
+#define WHEEL_LINES	3
+#define WHEEL_ZOOM	1.25f
+
 API_EXPORT void
 mouse(void *userdata, i32 x, i32 y, i32 dz, u32 buttons)
 {
-	unused(dz);
-
 	app_state *state = (app_state *)userdata;
 
 	state->mouse_x = x;
 	state->mouse_y = y;
 	state->mouse_buttons = buttons;
+
+	// below the console the wheel zooms the distance field text, which
+	// never rasterizes a glyph again.
+	if (y < CONSOLE_VIEW_Y) {
+		f32 scale = state->sdf_scale;
+		for (i32 notch = dz; notch >= 120; notch -= 120)
+			scale *= WHEEL_ZOOM;
+		for (i32 notch = dz; notch <= -120; notch += 120)
+			scale /= WHEEL_ZOOM;
+		state->sdf_scale = max(min(scale, SDF_MAX_SCALE), SDF_MIN_SCALE);
+	}
+	else if (state->file.file.sys)
+		state->file.scroll += dz * WHEEL_LINES / 120;
+	else
+		state->console.scroll += dz * WHEEL_LINES / 120;
+}
+
+API_EXPORT void
+open_file(void *userdata, const char *path)
+{
+	app_state *state = (app_state *)userdata;
+	file_view& v = state->file;
+
+	if (v.file.sys) {
+		while (atomic_load(&v.indexing))
+			sys_complete_work();
+		sys_unmap_file(&v.file);
+	}
+
+	reset_file_index(v);
+	v.top = 0;
+	v.scroll = 0;
+	v.follow = true;
+	v.open_ticks = sys_ticks();
+	v.first_frame_ticks = 0;
+
+	if (!sys_map_file(path, &v.file)) {
+		char buf[256];
+		char *end = buf + sizeof(buf);
+		char *p = copy_string(buf, end, "could not open ");
+		p = copy_string(p, end, path);
+		p = copy_string(p, end, "\n");
+		append_console(state->console, buf, (size_t)(p - buf));
+	}
 }
 
+// ctrl+f
+#define KEY_FILL_CONSOLE	0x06
+// ctrl+g
+#define KEY_GPU_LOG		0x07
+// ctrl+p
+#define KEY_EXPORT_TRACE	0x10
+// ctrl+r
+#define KEY_CYCLE_PACING	0x12
+// ctrl+t
+#define KEY_TOGGLE_PANELS	0x14
+
 API_EXPORT void
 keyboard(void *userdata, u32 codepoint)
 {
-	unused(userdata);
-	unused(codepoint);
+	app_state *state = (app_state *)userdata;
+
+	if (codepoint == KEY_FILL_CONSOLE)
+		fill_console(state->console, 1000000);
+
+	if (codepoint == KEY_TOGGLE_PANELS)
+		state->panels.on = !state->panels.on;
+
+	if (codepoint == KEY_GPU_LOG) {
+		gpu_timer& t = state->gpu;
+		t.log = !t.log;
+		if (!t.log)
+			flush_gpu_log(t);
+	}
+
+	// on demand, fixed rate, vsync.
+	if (codepoint == KEY_CYCLE_PACING) {
+		frame_pacing *pacing = sys_frame_pacing();
+		pacing->mode = (pacing->mode + 1) % 3;
+	}
+
+#if PROFILER
+	if (codepoint == KEY_EXPORT_TRACE)
+		state->profile.export_trace = true;
+#endif
 }
 
 API_EXPORT void
@@ -601,6 +5539,27 @@ render(void *userdata, i32 window_width, i32 window_height)
 {
 	app_state *state = (app_state *)userdata;
 
+	u64 now = sys_ticks();
+	state->frame_ticks = now - state->frame_start;
+	state->frame_start = now;
+
+	reset_arena(state->frame_arena);
+
+	profile_function();
+
+	++state->frame;
+
+#if PROFILER
+	read_profile_events(state->profile);
+#endif
+
+	receive_glyphs(state);
+	age_layouts(state);
+	update_file_view(state);
+
+	state->batch.last_stats = state->batch.stats;
+	state->batch.stats = {};
+
 	glViewport(0, 0, window_width, window_height);
 
 	f32 sx = 2.f / window_width;
@@ -611,37 +5570,59 @@ render(void *userdata, i32 window_width, i32 window_height)
 		 0.f,  0.f, 1.f, 0.f,
 		-1.f, -1.f, 0.f, 1.f,
 	};
-	glUseProgram(state->basic_program);
-	glUniformMatrix4fv(state->basic_uproj, 1, false, proj);
 	glUseProgram(state->texture_program);
 	glUniformMatrix4fv(state->texture_uproj, 1, false, proj);
+	glUseProgram(state->sdf_program);
+	glUniformMatrix4fv(state->sdf_uproj, 1, false, proj);
 	glUseProgram(0);
 
+	begin_gpu_frame(state);
+
+	gpu_pass(state, "clear");
 	glClearColor(0.02f, 0.02f, 0.02f, 1.f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	gpu_pass(state, "text");
+
 	////////
 	//
 	// some test rendering.
 
-	f32 z = 0.f;
-
 	vec4 white_color = { 1.f, 1.f, 1.f, 1.f };
 	vec4 red_color = { 1.f, 0.f, 0.f, 1.f };
 
 	vec2 cursor = { 100.f, 80.f };
 
 	const char *s = "The quick brown fox jumps over the lazy dog.\n";
-	cursor = draw_text(state, state->console_font, s, cursor, z, white_color);
-	cursor = draw_text(state, state->ui_font, s, cursor, z, white_color);
+	cursor = draw_text(state, state->console_font, s, cursor, white_color);
+	cursor = draw_text(state, state->ui_font, s, cursor, white_color);
+
+	const char *u = "Fa\xC3\xA7" "ade, na\xC3\xAFve, \xCE\xBA\xCF\x8C\xCF\x83\xCE\xBC\xCE\xB5, \xD0\xBC\xD0\xB8\xD1\x80, \xE2\x82\xAC\xE2\x80\x94ok\n";
+	cursor = draw_text(state, state->ui_font, u, cursor, white_color);
+
+	// anchored in the bottom left corner, it grows up and to the right.
+	const char *z = "The wheel zooms this line without rasterizing a glyph.";
+	draw_text(state, state->sdf_font, z, { 10.f, 8.f }, white_color, state->sdf_scale);
+
+	rect2d console_view = { 10.f, (f32)CONSOLE_VIEW_Y, (f32)window_width - 270.f, (f32)window_height - 40.f };
+	if (state->file.file.sys)
+		draw_file_view(state, state->file, console_view, white_color);
+	else if (state->panels.on)
+		draw_panels(state, state->console, console_view, white_color);
+	else
+		draw_console(state, state->console, console_view, white_color);
+
+	gpu_pass(state, "rects");
 
 	struct rect2d bounds = { 0.f, (f32)window_height - 32.f, (f32)window_width, (f32)window_height };
-	draw_rect2d(state, bounds, z, red_color);
+	draw_rect2d(state, bounds, red_color);
 
 	////////
 	//
 	// display user input state.
 
+	gpu_pass(state, "overlay");
+
 	state->debug_cursor.x = (f32)window_width - 250.f;
 	state->debug_cursor.y = (f32)window_height - line_height(state->console_font);
 
@@ -654,6 +5635,218 @@ render(void *userdata, i32 window_width, i32 window_height)
 	debug_text(state, buf);
 	fmt(buf, end, "buttons: 0x%08x\n", (i32)state->mouse_buttons);
 	debug_text(state, buf);
+
+	fmt(buf, end, "draws: %d\n", state->batch.last_stats.draw_count);
+	debug_text(state, buf);
+	fmt(buf, end, "quads: %d\n", state->batch.last_stats.quad_count);
+	debug_text(state, buf);
+	fmt(buf, end, "vertices: %d\n", 4 * state->batch.last_stats.quad_count);
+	debug_text(state, buf);
+	fmt(buf, end, "upload: %d bytes\n", (i32)state->batch.last_stats.upload_bytes);
+	debug_text(state, buf);
+	fmt(buf, end, "atlas upload: %d bytes\n", (i32)state->batch.last_stats.atlas_upload_bytes);
+	debug_text(state, buf);
+
+	glyph_atlas& atlas = state->atlas;
+
+	i64 used = 0;
+	i64 area = 0;
+	for (i32 i = 0; i < atlas.page_count; ++i) {
+		used += atlas.pages[i].used;
+		area += (i64)atlas.pages[i].size * atlas.pages[i].size;
+	}
+
+	fmt(buf, end, "atlas pages: %d\n", atlas.page_count);
+	debug_text(state, buf);
+	fmt(buf, end, "atlas used: %d%%\n", (i32)(100 * used / area));
+	debug_text(state, buf);
+	char *p = fmt(buf, end, "rasterized: %d", (i32)atlas.rasterized);
+	fmt(p, end, ", cached fonts %d\n", state->cached_fonts);
+	debug_text(state, buf);
+
+	// the distance fields of one size against the coverage of every
+	// size the text has been drawn at.
+	glyph_atlas& sdf = state->sdf_atlas;
+	i64 sdf_used = 0;
+	for (i32 i = 0; i < sdf.page_count; ++i)
+		sdf_used += sdf.pages[i].used;
+	char *q = fmt(buf, end, "sdf: %d%%", (i32)(state->sdf_scale * 100.f + .5f));
+	fmt(q, end, ", rasterized %d\n", (i32)sdf.rasterized);
+	debug_text(state, buf);
+	q = fmt(buf, end, "atlas bytes: %d", (i32)used);
+	fmt(q, end, ", sdf %d\n", (i32)sdf_used);
+	debug_text(state, buf);
+	fmt(buf, end, "evictions: %d\n", (i32)atlas.evictions);
+	debug_text(state, buf);
+	q = fmt(buf, end, "repacks: %d", atlas.repacks);
+	fmt(q, end, ", too large %d\n", (i32)(atlas.too_large + sdf.too_large));
+	debug_text(state, buf);
+	fmt(buf, end, "utf-8 errors: %d\n", (i32)state->utf8_errors);
+	debug_text(state, buf);
+
+	layout_cache& layouts = state->layouts;
+	i32 lookups = max(layouts.last_hits + layouts.last_misses, 1);
+	p = fmt(buf, end, "layouts: %d", LAYOUT_CACHE_SIZE - layouts.free_count);
+	fmt(p, end, ", hits %d%%\n", 100 * layouts.last_hits / lookups);
+	debug_text(state, buf);
+
+	// memory per line is its text and its start in the line ring.
+	text_console& con = state->console;
+	u64 lines = con.line_end - con.first_line;
+	u64 text = lines ? con.head - console_line_start(con, con.first_line) : 0;
+	q = fmt(buf, end, "console: %d lines", (i32)lines);
+	fmt(q, end, ", %d bytes each\n", (i32)((text + lines * sizeof(u64)) / max(lines, (u64)1)));
+	debug_text(state, buf);
+	u64 milliticks = con.append_ticks * 1000 / max(con.appended_lines, (u64)1);
+	fmt(buf, end, "append: %d ns/line\n", (i32)(milliticks * 1000000 / state->tick_frequency));
+	debug_text(state, buf);
+
+	debug_arena(state, state->permanent_arena);
+	debug_arena(state, state->state_arena);
+	debug_arena(state, state->frame_arena);
+	debug_pool(state, state->results);
+	debug_arena(state, con.text_arena);
+	debug_arena(state, con.line_arena);
+
+	const panel_view& pv = state->panels;
+	if (pv.on && !state->file.file.sys) {
+		p = fmt(buf, end, "panels: %d", PANEL_COLUMNS * PANEL_ROWS);
+		fmt(p, end, " on %d threads\n", pv.threads);
+		debug_text(state, buf);
+		p = fmt(buf, end, "record: %d us", (i32)(pv.record_ticks * 1000000 / state->tick_frequency));
+		fmt(p, end, ", merge %d\n", (i32)(pv.merge_ticks * 1000000 / state->tick_frequency));
+		debug_text(state, buf);
+	}
+
+	file_view& fv = state->file;
+	if (fv.file.sys) {
+		u64 indexed = atomic_load(&fv.indexed);
+		q = fmt(buf, end, "file: %d MB", (i32)(fv.file.size >> 20));
+		fmt(q, end, ", first frame %d us\n", (i32)(fv.first_frame_ticks * 1000000 / state->tick_frequency));
+		debug_text(state, buf);
+		q = fmt(buf, end, "lines: %d", (i32)atomic_load(&fv.line_count));
+		fmt(q, end, ", indexed %d%%\n", (i32)(fv.file.size ? 100 * indexed / fv.file.size : 100));
+		debug_text(state, buf);
+		u64 us = max(fv.index_ticks * 1000000 / state->tick_frequency, (u64)1);
+		fmt(buf, end, "index: %d MB/s\n", (i32)(indexed / us));
+		debug_text(state, buf);
+		debug_arena(state, fv.index_arena);
+	}
+
+	////////
+	//
+	// timing.
+
+	fmt(buf, end, "frame: %d us\n", (i32)(state->frame_ticks * 1000000 / state->tick_frequency));
+	debug_text(state, buf);
+	fmt(buf, end, "cpu: %d us\n", (i32)(state->render_ticks * 1000000 / state->tick_frequency));
+	debug_text(state, buf);
+
+	const frame_pacing& pacing = *sys_frame_pacing();
+	if (pacing.mode == PACING_FIXED) {
+		fmt(buf, end, "pacing: %d fps\n", pacing.target_fps);
+		debug_text(state, buf);
+	}
+	else
+		debug_text(state, pacing.mode == PACING_VSYNC ? "pacing: vsync\n" : "pacing: on demand\n");
+	p = fmt(buf, end, "wakeups: %d", (i32)pacing.wakeups);
+	fmt(p, end, ", frames %d\n", (i32)pacing.frames);
+	debug_text(state, buf);
+
+	i32 samples = (i32)min(pacing.latency_count, (u64)PACING_SAMPLES);
+	if (samples > 0) {
+		u64 sum = 0;
+		u64 worst = 0;
+		for (i32 i = 0; i < samples; ++i) {
+			sum += pacing.latency[i];
+			worst = max(worst, pacing.latency[i]);
+		}
+		u64 last = pacing.latency[(pacing.latency_count - 1) & (PACING_SAMPLES - 1)];
+
+		p = fmt(buf, end, "input to present: %d us", (i32)(last * 1000000 / state->tick_frequency));
+		p = fmt(p, end, ", avg %d", (i32)(sum / (u64)samples * 1000000 / state->tick_frequency));
+		fmt(p, end, ", max %d\n", (i32)(worst * 1000000 / state->tick_frequency));
+		debug_text(state, buf);
+	}
+
+	// the first load counts as a reload.
+	const code_reload& reloaded = *sys_code_reload();
+	if (reloaded.count > 1) {
+		p = fmt(buf, end, "reloads: %d", (i32)reloaded.count - 1);
+		fmt(p, end, ", last %d us\n", (i32)(reloaded.latency * 1000000 / state->tick_frequency));
+		debug_text(state, buf);
+		p = fmt(buf, end, "reload stage: %d us", (i32)(reloaded.stage_ticks * 1000000 / state->tick_frequency));
+		fmt(p, end, ", swap %d\n", (i32)(reloaded.swap_ticks * 1000000 / state->tick_frequency));
+		debug_text(state, buf);
+	}
+	if (reloaded.rejected) {
+		fmt(buf, end, "rejected builds: %d\n", (i32)reloaded.rejected);
+		debug_text(state, buf);
+	}
+
+	const gpu_timer& gpu = state->gpu;
+	u64 gpu_total = 0;
+	for (i32 i = 0; i < gpu.pass_count; ++i)
+		gpu_total += gpu.times[i];
+
+	fmt(buf, end, "gpu: %d us\n", (i32)(gpu_total / 1000));
+	debug_text(state, buf);
+	for (i32 i = 0; i < gpu.pass_count; ++i) {
+		char *p = copy_string(buf, end, "gpu ");
+		p = copy_string(p, end, gpu.names[i]);
+		fmt(p, end, ": %d us\n", (i32)(gpu.times[i] / 1000));
+		debug_text(state, buf);
+	}
+	if (gpu.dropped) {
+		fmt(buf, end, "gpu dropped: %d\n", gpu.dropped);
+		debug_text(state, buf);
+	}
+	if (gpu.log)
+		debug_text(state, "gpu log: " GPU_LOG_FILE "\n");
+
+#if PROFILER
+	const profile_view& view = state->profile;
+	for (i32 i = 0; i < view.shown_count; ++i) {
+		const zone_stats& z = view.shown[i];
+		char *p = copy_string(buf, end, z.name);
+		p = fmt(p, end, ": %d us", (i32)(z.ticks * 1000000 / state->tick_frequency / PROFILE_WINDOW));
+		fmt(p, end, " x%d\n", (z.count + PROFILE_WINDOW / 2) / PROFILE_WINDOW);
+		debug_text(state, buf);
+	}
+#endif
+
+	end_gpu_frame(state);
+	finish_region(state->batch);
+
+	if (state->frame % 64 == 0)
+		flush_gpu_log(state->gpu);
+
+	// glyphs rasterized since the glyph cache file was written go into it
+	// once none are in flight.
+	i64 rasterized = state->atlas.rasterized + state->sdf_atlas.rasterized;
+	if (rasterized != state->cache_rasterized && state->workers.in_flight == 0 &&
+	    now - state->cache_saved >= state->tick_frequency * GLYPH_CACHE_SAVE_MS / 1000)
+		save_glyph_cache(state);
+
+	// frames rendered on demand follow input, so work that goes on without
+	// it asks for them: glyphs on their way from the workers, and a file
+	// that may grow.
+	frame_pacing *next = sys_frame_pacing();
+	if (state->workers.in_flight > 0 || atomic_load(&state->file.indexing))
+		next->next_frame = now;
+	else if (state->file.file.sys)
+		next->next_frame = now + state->tick_frequency * FILE_POLL_MS / 1000;
+
+	state->render_ticks = sys_ticks() - now;
+
+#if PROFILER
+	if (state->profile.export_trace) {
+		state->profile.export_trace = false;
+		profile_export(global_profiler, "profile.json");
+	}
+#endif
 }
 
+#if defined(_WIN32)
 extern "C" int _fltused = 0;
+#endif
@@ -0,0 +1,1416 @@
+#include "shared.h"
+
+////////
+//
+// Linux Platform
+//
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+// freetype has struct members named internal.
+#pragma push_macro("internal")
+#undef internal
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#pragma pop_macro("internal")
+#include <fontconfig/fontconfig.h>
+
+#define GL_FRAMEBUFFER		0x8D40
+#define GL_RENDERBUFFER		0x8D41
+#define GL_COLOR_ATTACHMENT0	0x8CE0
+#define GL_FRAMEBUFFER_COMPLETE	0x8CD5
+
+// gl functions only the platform calls. the code module gets its own
+// through OPENGL_FUNCTIONS.
+#define HOST_OPENGL_FUNCTIONS	\
+	X(void, glGenFramebuffers, i32 n, u32 *framebuffers)	\
+	X(void, glBindFramebuffer, u32 target, u32 framebuffer)	\
+	X(u32, glCheckFramebufferStatus, u32 target)	\
+	X(void, glGenRenderbuffers, i32 n, u32 *renderbuffers)	\
+	X(void, glBindRenderbuffer, u32 target, u32 renderbuffer)	\
+	X(void, glRenderbufferStorage, u32 target, u32 internalformat, i32 width, i32 height)	\
+	X(void, glFramebufferRenderbuffer, u32 target, u32 attachment, u32 renderbuffertarget, u32 renderbuffer)	\
+	X(void, glReadPixels, i32 x, i32 y, i32 width, i32 height, u32 format, u32 type, void *pixels)	\
+	X(void, glFinish, void)	\
+	/* end */
+
+#define X(ret, name, ...)	\
+	static ret (*name)(__VA_ARGS__) = 0;
+	HOST_OPENGL_FUNCTIONS
+#undef X
+
+static char *global_codedir;
+static char *global_codename;
+static char *global_stagednames[2];
+static char *global_lockname;
+static void *global_code;
+static void *global_userdata;
+
+// the module the watcher staged and when the build wrote it. staged is set
+// after both, and cleared when the main loop takes the module.
+static void *global_staged_code;
+static u64 global_staged_written;
+static volatile u32 global_staged;
+
+// the watcher wakes the main loop through this eventfd.
+static int global_reload_event = -1;
+static code_reload global_reload;
+
+// when the build wrote the module that was swapped in, until a frame
+// rendered with it is presented.
+static u64 global_swapped_written;
+
+// given with --open, handed to the code after it is first loaded.
+static const char *global_open_path;
+
+#define X(ret, name, ...)	\
+	static ret (*name)(__VA_ARGS__) = 0;
+	CODE_FUNCTIONS
+#undef X
+
+////////
+//
+// Services provided by the platform.
+//
+
+void *
+sys_allocate(size_t size, size_t alignment, u32 flags)
+{
+	if (size == 0)
+		return 0;
+
+	void *p = 0;
+	if (alignment <= alignof(max_align_t)) {
+		p = (flags & ALLOCATE_ZERO) ? calloc(1, size) : malloc(size);
+	}
+	else if (posix_memalign(&p, alignment, size) == 0) {
+		if (flags & ALLOCATE_ZERO)
+			memset(p, 0, size);
+	}
+	assert(p && (uintptr_t)p % alignment == 0);
+	return p;
+}
+
+void
+sys_deallocate(void *p, size_t size, size_t alignment)
+{
+	unused(size);
+	unused(alignment);
+
+	free(p);
+}
+
+void *
+sys_reallocate(void *p, size_t size, size_t new_size, size_t alignment)
+{
+	if (alignment <= alignof(max_align_t)) {
+		// glibc grows large blocks with mremap, which does not copy.
+		p = realloc(p, new_size);
+		assert(p);
+		return p;
+	}
+
+	void *result = sys_allocate(new_size, alignment, 0);
+	if (p) {
+		memcpy(result, p, min(size, new_size));
+		free(p);
+	}
+	return result;
+}
+
+void *
+sys_reserve(size_t size)
+{
+	void *p = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return p == MAP_FAILED ? 0 : p;
+}
+
+bool
+sys_commit(void *p, size_t size)
+{
+	return mprotect(p, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void
+sys_release(void *p, size_t size)
+{
+	if (p)
+		munmap(p, size);
+}
+
+// a font instance owns its own FreeType library, so that instances can be
+// used on different threads at the same time.
+struct linux_font
+{
+	FT_Library library;
+	FT_Face face;
+};
+
+bool
+sys_find_font_file(const wchar_t *name, char *path, size_t n, i32 *index)
+{
+	char family[256];
+	size_t len = 0;
+	while (name[len] && len + 1 < sizeof(family)) {
+		family[len] = name[len] < 0x80 ? (char)name[len] : '?';
+		++len;
+	}
+	family[len] = 0;
+
+	bool result = false;
+
+	FcInit();
+	FcPattern *pattern = FcPatternCreate();
+	FcPatternAddString(pattern, FC_FAMILY, (const FcChar8 *)family);
+	FcConfigSubstitute(0, pattern, FcMatchPattern);
+	FcDefaultSubstitute(pattern);
+
+	FcResult match;
+	FcPattern *font = FcFontMatch(0, pattern, &match);
+	if (font) {
+		FcChar8 *file = 0;
+		int i = 0;
+		if (FcPatternGetString(font, FC_FILE, 0, &file) == FcResultMatch) {
+			FcPatternGetInteger(font, FC_INDEX, 0, &i);
+			size_t m = strlen((const char *)file);
+			if (m < n) {
+				memcpy(path, file, m + 1);
+				*index = i;
+				result = true;
+			}
+		}
+		FcPatternDestroy(font);
+	}
+	FcPatternDestroy(pattern);
+
+	return result;
+}
+
+struct font *
+sys_create_font(const wchar_t *name, i32 pixel_height)
+{
+	struct font *result = allocate<font>(1, ALLOCATE_ZERO);
+
+	i32 len = 0;
+	while (name[len])
+		++len;
+	wchar_t *name_copy = allocate<wchar_t>((size_t)len + 1);
+	copy_n(len + 1, name_copy, name);
+	result->name = name_copy;
+	result->pixel_height = pixel_height;
+
+	linux_font *lf = allocate<linux_font>(1, ALLOCATE_ZERO);
+	result->sys = lf;
+
+	// same scale as the windows platform at 96 dpi.
+	i32 size = pixel_height * 96 / 72;
+
+	char path[4096];
+	i32 index = 0;
+	if (sys_find_font_file(name, path, sizeof(path), &index) &&
+	    FT_Init_FreeType(&lf->library) == 0 &&
+	    FT_New_Face(lf->library, path, index, &lf->face) == 0) {
+		FT_Set_Pixel_Sizes(lf->face, 0, (FT_UInt)size);
+
+		const FT_Size_Metrics& m = lf->face->size->metrics;
+		result->ascent = (i32)((m.ascender + 63) >> 6);
+		result->descent = (i32)((-m.descender + 63) >> 6);
+		result->height = result->ascent + result->descent;
+		result->external_leading = max((i32)((m.height + 63) >> 6) - result->height, 0);
+		result->default_x = (i32)((m.max_advance + 63) >> 6);
+
+		FT_Load_Char(lf->face, 'x', FT_LOAD_DEFAULT);
+		result->average_width = (i32)((lf->face->glyph->advance.x + 32) >> 6);
+	}
+	else {
+		// no usable font. glyphs render empty, but the metrics stay sane.
+		result->ascent = size - size / 4;
+		result->descent = size / 4;
+		result->height = size;
+		result->default_x = size;
+		result->average_width = size / 2;
+	}
+
+	result->default_x = max(result->default_x, 1);
+	result->default_y = result->height;
+	result->bitmap_width = result->default_x * 3;
+	result->bitmap_height = result->height * 3;
+	result->bits = allocate<u32>((size_t)(result->bitmap_width * result->bitmap_height));
+
+	return result;
+}
+
+// renders like the windows platform does: the glyph cell starts at
+// (default_x, default_y) and the bitmap is stored bottom-up.
+i32
+sys_render_glyph(struct font *font, u32 codepoint)
+{
+	u32 *dst = font->bits;
+	i32 i = font->bitmap_width * font->bitmap_height;
+	while (i--)
+		*dst++ = 0;
+
+	// distance fields are drawn scaled, off the grid hinting would snap
+	// their outlines to.
+	u32 hinting = font->sdf_spread ? FT_LOAD_NO_HINTING : FT_LOAD_TARGET_NORMAL;
+
+	linux_font *lf = (linux_font *)font->sys;
+	if (!lf->face || FT_Load_Char(lf->face, codepoint, FT_LOAD_RENDER | hinting) != 0)
+		return 0;
+
+	FT_GlyphSlot slot = lf->face->glyph;
+	const FT_Bitmap& bitmap = slot->bitmap;
+
+	i32 baseline = font->default_y + font->descent;
+	i32 x0 = font->default_x + slot->bitmap_left;
+	i32 y0 = baseline + slot->bitmap_top - 1;
+
+	if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY) {
+		for (u32 row = 0; row < bitmap.rows; ++row) {
+			i32 y = y0 - (i32)row;
+			if (y < 0 || y >= font->bitmap_height)
+				continue;
+
+			const u8 *src = bitmap.buffer + (i32)row * bitmap.pitch;
+			u32 *line = font->bits + y * font->bitmap_width;
+			for (u32 col = 0; col < bitmap.width; ++col) {
+				i32 x = x0 + (i32)col;
+				if (x < 0 || x >= font->bitmap_width)
+					continue;
+
+				u32 c = src[col];
+				line[x] = c | (c << 8) | (c << 16);
+			}
+		}
+	}
+
+	return (i32)((slot->advance.x + 32) >> 6);
+}
+
+u64
+sys_ticks(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+u64
+sys_tick_frequency(void)
+{
+	return 1000000000ull;
+}
+
+bool
+sys_write_file(const char *path, const void *data, size_t size, bool append)
+{
+	int file = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+	if (file < 0)
+		return false;
+
+	const u8 *p = (const u8 *)data;
+	while (size) {
+		ssize_t n = write(file, p, size);
+		if (n <= 0)
+			break;
+		p += n;
+		size -= (size_t)n;
+	}
+
+	close(file);
+	return size == 0;
+}
+
+////////
+//
+// mapped files. the file is mapped into a window of address space much
+// larger than the file, so it can grow without moving. pages past the end
+// of the file are never touched. inotify tells when to look at the size
+// again.
+
+#define MAPPED_FILE_WINDOW	((u64)1 << 36)
+
+// notify of a file that is not watched yet.
+#define NOTIFY_LATER	-2
+
+struct linux_file
+{
+	int fd;
+	int notify;
+	u64 window;
+};
+
+internal bool
+map_window(mapped_file *file, linux_file *f, u64 size)
+{
+	f->window = max(MAPPED_FILE_WINDOW, 2 * size);
+	void *p = mmap(0, f->window, PROT_READ, MAP_SHARED | MAP_NORESERVE, f->fd, 0);
+	if (p == MAP_FAILED)
+		return false;
+
+	file->data = (const u8 *)p;
+	file->size = size;
+	return true;
+}
+
+bool
+sys_map_file(const char *path, mapped_file *file)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	linux_file *f = allocate<linux_file>(1, ALLOCATE_ZERO);
+	f->fd = fd;
+
+	if (fstat(fd, &st) != 0 || !map_window(file, f, (u64)st.st_size)) {
+		close(fd);
+		sys_deallocate(f, sizeof(linux_file), alignof(linux_file));
+		return false;
+	}
+
+	// closing an inotify instance waits for the kernel to retire it, which
+	// takes milliseconds, so only files that are updated get one.
+	f->notify = NOTIFY_LATER;
+
+	file->sys = f;
+	return true;
+}
+
+bool
+sys_update_file(mapped_file *file)
+{
+	linux_file *f = (linux_file *)file->sys;
+
+	// without inotify the size is checked on every update.
+	if (f->notify == NOTIFY_LATER) {
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/self/fd/%d", f->fd);
+		f->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (f->notify >= 0 && inotify_add_watch(f->notify, path, IN_MODIFY) < 0) {
+			close(f->notify);
+			f->notify = -1;
+		}
+	}
+	else if (f->notify >= 0) {
+		char events[4096];
+		bool modified = false;
+		while (read(f->notify, events, sizeof(events)) > 0)
+			modified = true;
+		if (!modified)
+			return false;
+	}
+
+	struct stat st;
+	if (fstat(f->fd, &st) != 0 || (u64)st.st_size == file->size)
+		return false;
+
+	u64 size = (u64)st.st_size;
+	if (size > f->window) {
+		munmap((void *)file->data, f->window);
+		bool ok = map_window(file, f, size);
+		assert(ok);
+	}
+
+	file->size = size;
+	return true;
+}
+
+void
+sys_unmap_file(mapped_file *file)
+{
+	linux_file *f = (linux_file *)file->sys;
+
+	munmap((void *)file->data, f->window);
+	close(f->fd);
+	if (f->notify >= 0)
+		close(f->notify);
+	sys_deallocate(f, sizeof(linux_file), alignof(linux_file));
+
+	*file = {};
+}
+
+struct profiler *
+sys_profiler(void)
+{
+#if PROFILER
+	return global_profiler;
+#else
+	return 0;
+#endif
+}
+
+internal void
+start_profiler(void)
+{
+#if PROFILER
+	global_profiler = allocate<profiler>(1, ALLOCATE_ZERO);
+	global_profiler->frequency = sys_tick_frequency();
+#endif
+}
+
+////////
+//
+// frame pacing. between frames the main loop sleeps in poll on a timerfd,
+// the X connection and the reload eventfd, so a window nothing happens in
+// costs no cpu.
+//
+
+#define DEFAULT_FPS	60
+
+static frame_pacing global_pacing;
+static int global_timer = -1;
+
+struct frame_pacing *
+sys_frame_pacing(void)
+{
+	return &global_pacing;
+}
+
+internal void
+start_pacing(i32 mode, i32 fps)
+{
+	global_pacing.mode = mode;
+	global_pacing.target_fps = fps;
+	global_pacing.next_frame = ~0ull;
+	global_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	assert(global_timer >= 0);
+}
+
+// sleeps until the sys_ticks time due, until new code is staged or until
+// fd has something to read. due may be ~0 and fd may be -1.
+internal void
+wait_until(u64 due, int fd)
+{
+	profile_zone("wait");
+
+	// sys_ticks are nanoseconds of CLOCK_MONOTONIC, the clock of the timer.
+	// a zero time disarms it.
+	struct itimerspec t = {};
+	if (due != ~0ull) {
+		t.it_value.tv_sec = (time_t)(due / 1000000000ull);
+		t.it_value.tv_nsec = (long)(due % 1000000000ull);
+	}
+	timerfd_settime(global_timer, TFD_TIMER_ABSTIME, &t, 0);
+
+	struct pollfd fds[3] = {
+		{ global_timer, POLLIN, 0 },
+		{ global_reload_event, POLLIN, 0 },
+		{ fd, POLLIN, 0 },
+	};
+	poll(fds, fd >= 0 ? 3 : 2, -1);
+
+	// the main loop looks for staged code after each wakeup.
+	for (i32 i = 0; i < 2; ++i) {
+		if (fds[i].revents & POLLIN) {
+			u64 count;
+			ssize_t n = read(fds[i].fd, &count, sizeof(count));
+			unused(n);
+		}
+	}
+
+	++global_pacing.wakeups;
+}
+
+internal inline void
+note_input(u64& input, bool& dirty)
+{
+	if (!input)
+		input = sys_ticks();
+	dirty = true;
+}
+
+internal inline u64
+cpu_time_us(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (u64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull +
+		(u64)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+////////
+//
+// work queue. the same ring as on windows: filled by the render thread and
+// drained by the worker threads, which sleep on a semaphore while it is
+// empty.
+
+#define WORK_QUEUE_SIZE	1024
+
+struct work_entry
+{
+	work_proc *proc;
+	void *data;
+};
+
+struct work_queue
+{
+	volatile u32 completion_goal;
+	volatile u32 completion_count;
+
+	volatile u32 next_write;
+	volatile u32 next_read;
+
+	sem_t semaphore;
+	i32 worker_count;
+	u32 pad;
+
+	work_entry entries[WORK_QUEUE_SIZE];
+};
+
+static work_queue global_work;
+
+// the worker index + 1 of worker threads, and 0 elsewhere.
+static __thread i32 global_thread_index;
+
+i32
+sys_worker_count(void)
+{
+	return global_work.worker_count;
+}
+
+// must only be called from the render thread.
+void
+sys_add_work(work_proc *proc, void *data)
+{
+	work_queue& q = global_work;
+
+	u32 write = q.next_write;
+	u32 next = (write + 1) % WORK_QUEUE_SIZE;
+	assert(next != atomic_load(&q.next_read));
+
+	work_entry& e = q.entries[write];
+	e.proc = proc;
+	e.data = data;
+	atomic_add(&q.completion_goal, 1);
+
+	atomic_store(&q.next_write, next);
+	sem_post(&q.semaphore);
+}
+
+// returns false if there was nothing to do.
+internal bool
+do_next_work(i32 worker)
+{
+	work_queue& q = global_work;
+
+	u32 read = atomic_load(&q.next_read);
+	if (read == atomic_load(&q.next_write))
+		return false;
+
+	u32 next = (read + 1) % WORK_QUEUE_SIZE;
+	if (atomic_compare_exchange(&q.next_read, read, next)) {
+		work_entry e = q.entries[read];
+		e.proc(worker, e.data);
+		atomic_add(&q.completion_count, 1);
+	}
+
+	return true;
+}
+
+i32
+sys_thread_index(void)
+{
+	i32 worker = global_thread_index;
+	return worker ? worker - 1 : global_work.worker_count;
+}
+
+// runs queued work on the calling thread until all of it is done.
+void
+sys_complete_work(void)
+{
+	work_queue& q = global_work;
+
+	while (atomic_load(&q.completion_goal) != atomic_load(&q.completion_count))
+		do_next_work(q.worker_count);
+
+	atomic_store(&q.completion_goal, 0);
+	atomic_store(&q.completion_count, 0);
+}
+
+// gives the rest of the time slice to another thread that is ready to run.
+void
+sys_yield(void)
+{
+	sched_yield();
+}
+
+internal void *
+worker_thread_proc(void *param)
+{
+	i32 worker = (i32)(uintptr_t)param;
+	global_thread_index = worker + 1;
+
+	for (;;) {
+		if (!do_next_work(worker))
+			sem_wait(&global_work.semaphore);
+	}
+}
+
+internal void
+start_workers(i32 count)
+{
+	global_work.worker_count = max(min(count, MAX_WORKER_THREADS), 0);
+	sem_init(&global_work.semaphore, 0, 0);
+
+	for (i32 i = 0; i < global_work.worker_count; ++i) {
+		pthread_t thread;
+		pthread_create(&thread, 0, worker_thread_proc, (void *)(uintptr_t)i);
+		pthread_detach(thread);
+	}
+}
+
+////////
+
+internal inline char *
+make_filename(size_t n, const char *path, const char *name)
+{
+	size_t len = strlen(name);
+
+	char *result = allocate<char>(n + len + 1);
+	memcpy(result, path, n);
+	memcpy(result + n, name, len + 1);
+
+	return result;
+}
+
+internal bool
+copy_file(const char *from, const char *to)
+{
+	int in = open(from, O_RDONLY);
+	if (in < 0)
+		return false;
+
+	// a new file, so the loader never sees the old mapping change under it.
+	unlink(to);
+	int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+	if (out < 0) {
+		close(in);
+		return false;
+	}
+
+	bool result = true;
+	char buf[64 * 1024];
+	ssize_t n;
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		if (write(out, buf, (size_t)n) != n) {
+			result = false;
+			break;
+		}
+	}
+
+	close(out);
+	close(in);
+	return result && n == 0;
+}
+
+internal inline bool
+is_newer(const struct timespec& a, const struct timespec& b)
+{
+	return a.tv_sec > b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec > b.tv_nsec);
+}
+
+// copies the module to a staging name and loads it from there, so the
+// build can replace code.so again while it runs. returns 0 if it does not
+// load or misses a function.
+internal void *
+stage_code(const char *path)
+{
+	if (!copy_file(global_codename, path))
+		return 0;
+
+	void *code = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!code) {
+		fprintf(stderr, "%s\n", dlerror());
+		return 0;
+	}
+
+	bool complete = true;
+	#define X(ret, name, ...)	\
+		complete = complete && dlsym(code, #name) != 0;
+
+		CODE_FUNCTIONS
+		OPENGL_FUNCTIONS
+		SYSTEM_FUNCTIONS
+	#undef X
+
+	if (!complete) {
+		fprintf(stderr, "%s misses functions\n", path);
+		dlclose(code);
+		return 0;
+	}
+
+	return code;
+}
+
+internal void
+publish_code(void *code, u64 written)
+{
+	global_staged_code = code;
+	global_staged_written = written;
+	atomic_store(&global_staged, 1);
+
+	u64 one = 1;
+	ssize_t n = write(global_reload_event, &one, sizeof(one));
+	unused(n);
+}
+
+// the build holds build.lock while it writes code.so. once the lock is
+// gone and code.so is newer than the module last staged, the next module
+// is staged under the other name than the one in use.
+internal void *
+watch_code_thread(void *param)
+{
+	struct timespec lastwrite = *(struct timespec *)param;
+	i32 slot = 1;
+
+	int notify = inotify_init1(IN_CLOEXEC);
+	if (notify < 0 || inotify_add_watch(notify, global_codedir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+		fprintf(stderr, "no inotify, code is not reloaded\n");
+		return 0;
+	}
+
+	u64 written = 0;
+	alignas(struct inotify_event) char events[4096];
+
+	for (;;) {
+		ssize_t n = read(notify, events, sizeof(events));
+		if (n <= 0)
+			continue;
+
+		u64 now = sys_ticks();
+		bool relevant = false;
+		for (char *p = events; p < events + n;) {
+			struct inotify_event *e = (struct inotify_event *)p;
+			if (e->len && strcmp(e->name, "code.so") == 0) {
+				relevant = true;
+				if (!written)
+					written = now;
+			}
+			if (e->len && strcmp(e->name, "build.lock") == 0)
+				relevant = true;
+			p += sizeof(struct inotify_event) + e->len;
+		}
+
+		struct stat st;
+		if (!relevant || access(global_lockname, F_OK) == 0 ||
+		    stat(global_codename, &st) != 0 || !is_newer(st.st_mtim, lastwrite))
+			continue;
+
+		// the main loop takes a module within a frame of being woken.
+		while (atomic_load(&global_staged))
+			usleep(1000);
+
+		u64 start = sys_ticks();
+		void *code = stage_code(global_stagednames[slot]);
+		lastwrite = st.st_mtim;
+		if (!code) {
+			++global_reload.rejected;
+			written = 0;
+			continue;
+		}
+
+		global_reload.stage_ticks = sys_ticks() - start;
+		publish_code(code, written ? written : start);
+		slot ^= 1;
+		written = 0;
+	}
+}
+
+// swaps in the module the watcher staged, if there is one. the main loop
+// calls it between frames; true means the code changed.
+internal bool
+swap_code(void)
+{
+	if (!atomic_load(&global_staged))
+		return false;
+
+	profile_function();
+
+	u64 start = sys_ticks();
+
+	// queued work may point into the old code.
+	sys_complete_work();
+
+	if (global_code) {
+		// the old code hands over its state in a form the new code
+		// understands.
+		u64 (*layout)(void) = (u64 (*)(void))dlsym(global_staged_code, "state_layout");
+		global_userdata = migrate(global_userdata, layout());
+
+		dlclose(global_code);
+		global_code = 0;
+#if PROFILER
+		// the events name zones in the unloaded code.
+		profile_reset(global_profiler);
+#endif
+	}
+
+	global_code = global_staged_code;
+	global_swapped_written = global_staged_written;
+	atomic_store(&global_staged, 0);
+
+	#define X(ret, name, ...)	\
+		name = (ret (*)(__VA_ARGS__))dlsym(global_code, #name);
+
+		CODE_FUNCTIONS
+	#undef X
+
+	#define X(ret, name, ...)		\
+		do {				\
+			ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))dlsym(global_code, #name);	\
+			*fn = (ret (*)(__VA_ARGS__))eglGetProcAddress(#name);	\
+			assert(*fn);		\
+		} while (0);
+
+		OPENGL_FUNCTIONS
+	#undef X
+
+	#define X(ret, name, ...)		\
+		do {				\
+			ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))dlsym(global_code, #name);	\
+			*fn = name;	\
+		} while (0);
+
+		SYSTEM_FUNCTIONS
+	#undef X
+
+	bool first = !global_userdata;
+	global_userdata = reload(global_userdata);
+	if (first && global_open_path)
+		open_file(global_userdata, global_open_path);
+
+	++global_reload.count;
+	global_reload.swap_ticks = sys_ticks() - start;
+	return true;
+}
+
+// called after a frame is presented. the first frame rendered with new
+// code ends the reload.
+internal inline void
+code_presented(u64 now)
+{
+	if (!global_swapped_written)
+		return;
+
+	global_reload.latency = now - global_swapped_written;
+	global_swapped_written = 0;
+
+	if (global_reload.count > 1) {
+		printf("reloaded code in %.3f ms: staged in %.3f ms, swapped in %.3f ms\n",
+		       (double)global_reload.latency * 1e-6, (double)global_reload.stage_ticks * 1e-6,
+		       (double)global_reload.swap_ticks * 1e-6);
+		fflush(stdout);
+	}
+}
+
+code_reload *
+sys_code_reload(void)
+{
+	return &global_reload;
+}
+
+// loads the code for the first time and starts watching for new builds.
+internal bool
+load_code(void)
+{
+	char exename[4096];
+	ssize_t n = readlink("/proc/self/exe", exename, sizeof(exename) - 1);
+	assert(n > 0);
+
+	while (n && exename[n - 1] != '/')
+		--n;
+
+	global_codedir = make_filename((size_t)n, exename, ".");
+	global_codename = make_filename((size_t)n, exename, "code.so");
+	global_stagednames[0] = make_filename((size_t)n, exename, "loaded.so");
+	global_stagednames[1] = make_filename((size_t)n, exename, "loaded2.so");
+	global_lockname = make_filename((size_t)n, exename, "build.lock");
+	global_reload_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	// a build in progress finishes first.
+	while (access(global_lockname, F_OK) == 0)
+		usleep(10000);
+
+	u64 start = sys_ticks();
+	struct stat st;
+	void *code = stat(global_codename, &st) == 0 ? stage_code(global_stagednames[0]) : 0;
+	if (!code) {
+		fprintf(stderr, "could not load %s\n", global_codename);
+		return false;
+	}
+
+	static struct timespec lastwrite;
+	lastwrite = st.st_mtim;
+	global_reload.stage_ticks = sys_ticks() - start;
+	publish_code(code, start);
+	swap_code();
+
+	pthread_t thread;
+	pthread_create(&thread, 0, watch_code_thread, &lastwrite);
+	pthread_detach(thread);
+	return true;
+}
+
+internal void
+load_host_opengl(void)
+{
+	#define X(ret, name, ...)	\
+		name = (ret (*)(__VA_ARGS__))eglGetProcAddress(#name);	\
+		assert(name);
+
+		HOST_OPENGL_FUNCTIONS
+	#undef X
+}
+
+internal EGLContext
+create_context(EGLDisplay display, EGLConfig config)
+{
+	const EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+
+	eglBindAPI(EGL_OPENGL_API);
+	return eglCreateContext(display, config, EGL_NO_CONTEXT, attribs);
+}
+
+////////
+//
+// headless mode. renders a fixed number of frames into an offscreen
+// framebuffer, without a window system, and reports the frame times and
+// the cpu time they took.
+//
+
+struct headless_options
+{
+	i32 frames;
+	i32 width;
+	i32 height;
+
+	// frames are paced like in a window with --fps, on demand for 0.
+	// without it they are rendered back to back. a paced run lasts seconds
+	// when that is given, however many frames it renders.
+	i32 fps;
+	i32 seconds;
+	u32 pad;
+
+	const char *dump;
+	const char *trace;
+	const char *keys;	// typed before the first frame
+};
+
+internal void
+write_ppm(const char *path, i32 w, i32 h)
+{
+	u8 *pixels = allocate<u8>((size_t)(w * h * 4));
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	FILE *f = fopen(path, "wb");
+	if (f) {
+		fprintf(f, "P6\n%d %d\n255\n", w, h);
+		for (i32 y = h - 1; y >= 0; --y)
+			for (i32 x = 0; x < w; ++x)
+				fwrite(pixels + (y * w + x) * 4, 1, 3, f);
+		fclose(f);
+	}
+
+	sys_deallocate(pixels, (size_t)(w * h * 4), 1);
+}
+
+internal int
+run_headless(const headless_options& options)
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (eglGetPlatformDisplayEXT)
+		display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0)) {
+		fprintf(stderr, "no EGL display\n");
+		return 1;
+	}
+
+	const EGLint config_attribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_SURFACE_TYPE, 0,
+		EGL_NONE,
+	};
+	EGLConfig config = 0;
+	EGLint count = 0;
+	eglChooseConfig(display, config_attribs, &config, 1, &count);
+
+	EGLContext context = create_context(display, count ? config : 0);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fprintf(stderr, "no OpenGL 3.3 core context\n");
+		return 1;
+	}
+
+	load_host_opengl();
+
+	u32 framebuffer, renderbuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, options.width, options.height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+	if (options.fps < 0)
+		start_pacing(PACING_VSYNC, DEFAULT_FPS);
+	else
+		start_pacing(options.fps ? PACING_FIXED : PACING_ON_DEMAND, options.fps ? options.fps : DEFAULT_FPS);
+
+	u64 start = sys_ticks();
+	if (!load_code())
+		return 1;
+	u64 load = sys_ticks() - start;
+
+	// keys typed before the first frame are input it presents.
+	u64 input = options.keys && *options.keys ? sys_ticks() : 0;
+	for (const char *k = options.keys; k && *k; ++k)
+		keyboard(global_userdata, (u8)*k);
+
+	u64 frequency = sys_tick_frequency();
+	u64 begin = sys_ticks();
+	u64 end = options.fps >= 0 && options.seconds > 0 ? begin + (u64)options.seconds * frequency : ~0ull;
+	i32 frames = options.fps >= 0 && options.seconds > 0 ? 0x7FFFFFFF : options.frames;
+	u64 begin_cpu = cpu_time_us();
+
+	u64 last_frame = 0;
+	bool dirty = true;
+
+	i32 rendered = 0;
+	u64 total = 0;
+	u64 lowest = ~0ull;
+	u64 highest = 0;
+	for (u64 now = begin; rendered < frames && now < end; now = sys_ticks()) {
+		if (swap_code())
+			dirty = true;
+
+		u64 due = next_frame_due(global_pacing, last_frame, frequency, dirty);
+		if (due > now) {
+			wait_until(min(due, end), -1);
+			continue;
+		}
+		last_frame = frame_start_time(global_pacing, due, now, frequency);
+		dirty = false;
+
+		u64 t0 = sys_ticks();
+		global_pacing.next_frame = ~0ull;
+		render(global_userdata, options.width, options.height);
+		{
+			profile_zone("glFinish");
+			glFinish();
+		}
+		u64 t = sys_ticks() - t0;
+		frame_presented(global_pacing, input, t0 + t);
+		code_presented(t0 + t);
+		input = 0;
+
+		++rendered;
+		total += t;
+		lowest = min(lowest, t);
+		highest = max(highest, t);
+	}
+
+	u64 wall_us = (sys_ticks() - begin) / 1000;
+	u64 cpu_us = cpu_time_us() - begin_cpu;
+
+	printf("load %.3f ms\n", (double)load * 1e-6);
+	if (rendered > 0) {
+		printf("frames %d, min %.3f ms, avg %.3f ms, max %.3f ms\n", rendered,
+		       (double)lowest * 1e-6, (double)total * 1e-6 / rendered, (double)highest * 1e-6);
+	}
+	printf("cpu %.3f ms in %.3f ms, %.2f%%, %d wakeups\n", (double)cpu_us * 1e-3, (double)wall_us * 1e-3,
+	       wall_us ? 100. * (double)cpu_us / (double)wall_us : 0., (i32)global_pacing.wakeups);
+
+	if (options.dump)
+		write_ppm(options.dump, options.width, options.height);
+
+#if PROFILER
+	if (options.trace && !profile_export(global_profiler, options.trace))
+		fprintf(stderr, "could not write %s\n", options.trace);
+#endif
+
+	sys_complete_work();
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	return 0;
+}
+
+////////
+//
+// windowed mode on X11.
+//
+
+internal inline u32
+x11_mouse_buttons(u32 state)
+{
+	u32 buttons = 0;
+	if (state & Button1Mask) buttons |= BUTTON_LEFT;
+	if (state & Button3Mask) buttons |= BUTTON_RIGHT;
+	return buttons;
+}
+
+internal int
+run_window(i32 width, i32 height, i32 fps)
+{
+	start_pacing(fps ? PACING_FIXED : PACING_ON_DEMAND, fps ? fps : DEFAULT_FPS);
+
+	Display *x11 = XOpenDisplay(0);
+	if (!x11) {
+		fprintf(stderr, "no X display, try --headless\n");
+		return 1;
+	}
+
+	EGLDisplay display = eglGetDisplay((EGLNativeDisplayType)x11);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0)) {
+		fprintf(stderr, "no EGL display\n");
+		return 1;
+	}
+
+	const EGLint config_attribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE,
+	};
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(display, config_attribs, &config, 1, &count) || count == 0) {
+		fprintf(stderr, "no EGL config\n");
+		return 1;
+	}
+
+	Window root = DefaultRootWindow(x11);
+	XSetWindowAttributes swa = {};
+	swa.event_mask = ExposureMask | StructureNotifyMask | KeyPressMask |
+		ButtonPressMask | ButtonReleaseMask | PointerMotionMask;
+	Window window = XCreateWindow(x11, root, 0, 0, (u32)width, (u32)height, 0,
+				      CopyFromParent, InputOutput, CopyFromParent, CWEventMask, &swa);
+	XStoreName(x11, window, "cpp-opengl-template");
+
+	Atom wm_delete = XInternAtom(x11, "WM_DELETE_WINDOW", False);
+	XSetWMProtocols(x11, window, &wm_delete, 1);
+	XMapWindow(x11, window);
+
+	const EGLint surface_attribs[] = {
+		EGL_GL_COLORSPACE_KHR, EGL_GL_COLORSPACE_SRGB_KHR,
+		EGL_NONE,
+	};
+	EGLSurface surface = eglCreateWindowSurface(display, config, (EGLNativeWindowType)window, surface_attribs);
+	if (surface == EGL_NO_SURFACE)
+		surface = eglCreateWindowSurface(display, config, (EGLNativeWindowType)window, 0);
+
+	EGLContext context = create_context(display, config);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+		fprintf(stderr, "no OpenGL 3.3 core context\n");
+		return 1;
+	}
+	eglSwapInterval(display, 1);
+
+	load_host_opengl();
+
+	if (!load_code())
+		return 1;
+
+	u64 frequency = sys_tick_frequency();
+	u64 last_frame = 0;
+
+	// input is the time of the first input event the next frame handles,
+	// dirty says something asked for a frame.
+	u64 input = 0;
+	bool dirty = true;
+
+	bool running = true;
+	while (running) {
+		if (swap_code())
+			dirty = true;
+
+		{
+			profile_zone("XNextEvent");
+			while (XPending(x11)) {
+				XEvent e;
+				XNextEvent(x11, &e);
+
+				switch (e.type) {
+					case Expose: {
+						dirty = true;
+					} break;
+
+					case ConfigureNotify: {
+						width = e.xconfigure.width;
+						height = e.xconfigure.height;
+						dirty = true;
+					} break;
+
+					case ClientMessage: {
+						if ((Atom)e.xclient.data.l[0] == wm_delete)
+							running = false;
+					} break;
+
+					case ButtonPress:
+					case ButtonRelease: {
+						u32 buttons = x11_mouse_buttons(e.xbutton.state);
+						u32 changed = 0;
+						if (e.xbutton.button == Button1) changed = BUTTON_LEFT;
+						if (e.xbutton.button == Button3) changed = BUTTON_RIGHT;
+						buttons = e.type == ButtonPress ? buttons | changed : buttons & ~changed;
+						note_input(input, dirty);
+
+						// one wheel notch is 120, as on windows.
+						i32 dz = 0;
+						if (e.type == ButtonPress && e.xbutton.button == Button4) dz = 120;
+						if (e.type == ButtonPress && e.xbutton.button == Button5) dz = -120;
+
+						mouse(global_userdata, e.xbutton.x, height - e.xbutton.y - 1, dz, buttons);
+					} break;
+
+					case MotionNotify: {
+						note_input(input, dirty);
+						mouse(global_userdata, e.xmotion.x, height - e.xmotion.y - 1, 0,
+						      x11_mouse_buttons(e.xmotion.state));
+					} break;
+
+					case KeyPress: {
+						char text[8];
+						KeySym keysym;
+						i32 n = XLookupString(&e.xkey, text, sizeof(text), &keysym, 0);
+
+						u32 codepoint = 0;
+						if ((keysym & 0xFF000000) == 0x01000000)
+							codepoint = (u32)(keysym & 0x00FFFFFF);
+						else if (n == 1)
+							codepoint = (u8)text[0];
+
+						note_input(input, dirty);
+						if (codepoint)
+							keyboard(global_userdata, codepoint);
+					} break;
+				}
+			}
+		}
+
+		if (!running)
+			break;
+
+		u64 due = next_frame_due(global_pacing, last_frame, frequency, dirty);
+		u64 now = sys_ticks();
+		if (due > now) {
+			wait_until(due, ConnectionNumber(x11));
+			continue;
+		}
+		last_frame = frame_start_time(global_pacing, due, now, frequency);
+
+		global_pacing.next_frame = ~0ull;
+		render(global_userdata, width, height);
+		{
+			profile_zone("eglSwapBuffers");
+			eglSwapBuffers(display, surface);
+		}
+
+		u64 presented = sys_ticks();
+		frame_presented(global_pacing, input, presented);
+		code_presented(presented);
+		input = 0;
+		dirty = false;
+	}
+
+	sys_complete_work();
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglDestroySurface(display, surface);
+	eglTerminate(display);
+	XDestroyWindow(x11, window);
+	XCloseDisplay(x11);
+	return 0;
+}
+
+internal inline i32
+parse_int(const char *s)
+{
+	i32 result = 0;
+	while (*s >= '0' && *s <= '9')
+		result = result * 10 + (*s++ - '0');
+	return result;
+}
+
+int
+main(int argc, char **argv)
+{
+	bool headless = false;
+	headless_options options = {};
+	options.frames = 100;
+	options.width = 1280;
+	options.height = 720;
+	options.fps = -1;
+
+	for (i32 i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		bool has_value = i + 1 < argc;
+
+		if (strcmp(arg, "--headless") == 0)
+			headless = true;
+		else if (strcmp(arg, "--frames") == 0 && has_value)
+			options.frames = parse_int(argv[++i]);
+		else if (strcmp(arg, "--width") == 0 && has_value)
+			options.width = max(parse_int(argv[++i]), 1);
+		else if (strcmp(arg, "--height") == 0 && has_value)
+			options.height = max(parse_int(argv[++i]), 1);
+		else if (strcmp(arg, "--fps") == 0 && has_value)
+			options.fps = parse_int(argv[++i]);
+		else if (strcmp(arg, "--seconds") == 0 && has_value)
+			options.seconds = parse_int(argv[++i]);
+		else if (strcmp(arg, "--dump") == 0 && has_value)
+			options.dump = argv[++i];
+		else if (strcmp(arg, "--trace") == 0 && has_value)
+			options.trace = argv[++i];
+		else if (strcmp(arg, "--keys") == 0 && has_value)
+			options.keys = argv[++i];
+		else if (strcmp(arg, "--open") == 0 && has_value)
+			global_open_path = argv[++i];
+		else {
+			fprintf(stderr, "usage: %s [--headless] [--frames n] [--width w] [--height h] [--fps n] [--seconds s] [--dump file.ppm] [--trace file.json] [--keys text] [--open file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	start_profiler();
+	start_workers((i32)sysconf(_SC_NPROCESSORS_ONLN) - 1);
+
+	if (headless)
+		return run_headless(options);
+	return run_window(options.width, options.height, max(options.fps, 0));
+}
@@ -36,13 +36,36 @@
 #define WGL_CONTEXT_DEBUG_BIT_ARB               0x0001
 #define WGL_CONTEXT_CORE_PROFILE_BIT_ARB        0x00000001
 
+static wchar_t *global_codedir;
 static wchar_t *global_codename;
-static wchar_t *global_loadedname;
+static wchar_t *global_stagednames[2];
 static wchar_t *global_lockname;
 static HMODULE global_code;
-static FILETIME global_lastwrite;
 static void *global_userdata;
 
+// the module the watcher staged and when the build wrote it. staged is set
+// after both, and cleared when the main loop takes the module.
+static HMODULE global_staged_code;
+static u64 global_staged_written;
+static volatile u32 global_staged;
+
+// the watcher wakes the main loop through this auto reset event.
+static HANDLE global_reload_event;
+static code_reload global_reload;
+
+// when the build wrote the module that was swapped in, until a frame
+// rendered with it is presented.
+static u64 global_swapped_written;
+
+// the first argument on the command line, handed to the code after it is
+// first loaded.
+static char global_open_path[MAX_PATH];
+
+// the time of the first input event the next frame handles, and whether
+// anything asked for a frame since the last one.
+static u64 global_input;
+static bool global_dirty = true;
+
 #define X(ret, name, ...)	\
 	static ret (*name)(__VA_ARGS__) = 0;
 	CODE_FUNCTIONS
@@ -53,18 +76,18 @@ static void *global_userdata;
 // Services provided by the platform.
 //
 
-internal inline void *
-sys_allocate(size_t size, size_t alignment)
+void *
+sys_allocate(size_t size, size_t alignment, u32 flags)
 {
 	if (size == 0)
 		return 0;
 
-	void *p = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, size);
+	void *p = HeapAlloc(GetProcessHeap(), (flags & ALLOCATE_ZERO) ? HEAP_ZERO_MEMORY : 0, size);
 	assert((uintptr_t)p % alignment == 0);
 	return p;
 }
 
-internal inline void
+void
 sys_deallocate(void *p, size_t size, size_t alignment)
 {
 	unused(size);
@@ -76,10 +99,125 @@ sys_deallocate(void *p, size_t size, size_t alignment)
 	HeapFree(GetProcessHeap(), 0, p);
 }
 
+void *
+sys_reallocate(void *p, size_t size, size_t new_size, size_t alignment)
+{
+	unused(size);
+
+	if (p == 0)
+		return sys_allocate(new_size, alignment, 0);
+
+	// large blocks live in their own virtual memory and may grow in place.
+	p = HeapReAlloc(GetProcessHeap(), 0, p, new_size);
+	assert(p && (uintptr_t)p % alignment == 0);
+	return p;
+}
+
+void *
+sys_reserve(size_t size)
+{
+	return VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool
+sys_commit(void *p, size_t size)
+{
+	return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+}
+
+void
+sys_release(void *p, size_t size)
+{
+	unused(size);
+
+	if (p)
+		VirtualFree(p, 0, MEM_RELEASE);
+}
+
+// installed fonts are registry values named after the fonts in the file,
+// like "Verdana (TrueType)" or "Cambria & Cambria Math (TrueType)". the
+// data is the file name, relative to the fonts directory unless it is a
+// full path.
+bool
+sys_find_font_file(const wchar_t *name, char *path, size_t size, i32 *index)
+{
+	HKEY key;
+	if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts", 0, KEY_READ, &key) != ERROR_SUCCESS)
+		return false;
+
+	bool result = false;
+	wchar_t value[256];
+	wchar_t file[MAX_PATH];
+
+	for (DWORD i = 0; !result; ++i) {
+		DWORD value_length = ARRAYSIZE(value);
+		DWORD file_bytes = sizeof(file) - sizeof(wchar_t);
+		DWORD type;
+		LONG status = RegEnumValueW(key, i, value, &value_length, 0, &type, (BYTE *)file, &file_bytes);
+		if (status == ERROR_NO_MORE_ITEMS)
+			break;
+		if (status != ERROR_SUCCESS || type != REG_SZ)
+			continue;
+		file[file_bytes / sizeof(wchar_t)] = 0;
+
+		// compare name with every font listed before the " (".
+		i32 font = 0;
+		for (const wchar_t *v = value; *v && *v != '(';) {
+			const wchar_t *n = name;
+			while (*n && *n == *v) {
+				++n;
+				++v;
+			}
+			if (!*n && (!*v || (v[0] == ' ' && (v[1] == '(' || v[1] == '&')))) {
+				*index = font;
+				result = true;
+				break;
+			}
+
+			while (*v && *v != '&' && *v != '(')
+				++v;
+			if (*v == '&') {
+				++font;
+				++v;
+				while (*v == ' ')
+					++v;
+			}
+		}
+	}
+
+	RegCloseKey(key);
+
+	if (result) {
+		wchar_t full[MAX_PATH + 64];
+		wchar_t *p = full;
+		if (!(file[0] && file[1] == ':') && file[0] != '\\') {
+			UINT n = GetWindowsDirectoryW(full, MAX_PATH);
+			p = full + n;
+			for (const wchar_t *dir = L"\\Fonts\\"; *dir; ++dir)
+				*p++ = *dir;
+		}
+		for (const wchar_t *f = file; *f && p < full + ARRAYSIZE(full) - 1; ++f)
+			*p++ = *f;
+		*p = 0;
+
+		result = WideCharToMultiByte(CP_ACP, 0, full, -1, path, (int)size, 0, 0) > 0;
+	}
+
+	return result;
+}
+
 struct font *
 sys_create_font(const wchar_t *name, i32 pixel_height)
 {
-	struct font *result = allocate<font>(1);
+	struct font *result = allocate<font>(1, ALLOCATE_ZERO);
+
+	i32 len = 0;
+	while (name[len])
+		++len;
+	wchar_t *name_copy = allocate<wchar_t>((size_t)len + 1);
+	copy_n(len + 1, name_copy, name);
+	result->name = name_copy;
+	result->pixel_height = pixel_height;
 
 	HDC dc = CreateCompatibleDC(0);
 	result->sys = dc;
@@ -106,6 +244,7 @@ sys_create_font(const wchar_t *name, i32 pixel_height)
 	result->descent = tm.tmAscent;
 	result->height = tm.tmHeight;
 	result->external_leading = tm.tmExternalLeading;
+	result->average_width = tm.tmAveCharWidth;
 
 	BITMAPINFO bi = {};
 	bi.bmiHeader.biSize = sizeof(bi.bmiHeader);
@@ -148,6 +287,383 @@ sys_render_glyph(struct font *font, u32 codepoint)
 	return result;
 }
 
+u64
+sys_ticks(void)
+{
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (u64)t.QuadPart;
+}
+
+u64
+sys_tick_frequency(void)
+{
+	LARGE_INTEGER f;
+	QueryPerformanceFrequency(&f);
+	return (u64)f.QuadPart;
+}
+
+bool
+sys_write_file(const char *path, const void *data, size_t size, bool append)
+{
+	HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, 0, append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = true;
+	if (append)
+		result = SetFilePointer(file, 0, 0, FILE_END) != INVALID_SET_FILE_POINTER;
+
+	const u8 *p = (const u8 *)data;
+	while (result && size) {
+		DWORD n = (DWORD)min(size, (size_t)1 << 30);
+		DWORD written = 0;
+		result = WriteFile(file, p, n, &written, 0) && written == n;
+		p += n;
+		size -= n;
+	}
+
+	CloseHandle(file);
+	return result;
+}
+
+////////
+//
+// mapped files. a view can not be larger than the file, so the file is
+// mapped again whenever its size changes. a change notification on the
+// directory of the file tells when to look at the size again.
+
+struct win32_file
+{
+	HANDLE file;
+	HANDLE mapping;
+	HANDLE notify;
+};
+
+internal bool
+map_view(mapped_file *file, win32_file *f)
+{
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(f->file, &size))
+		return false;
+
+	file->data = 0;
+	file->size = (u64)size.QuadPart;
+
+	// empty files can not be mapped.
+	if (file->size == 0)
+		return true;
+
+	f->mapping = CreateFileMappingA(f->file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!f->mapping)
+		return false;
+
+	file->data = (const u8 *)MapViewOfFile(f->mapping, FILE_MAP_READ, 0, 0, 0);
+	return file->data != 0;
+}
+
+internal void
+unmap_view(mapped_file *file, win32_file *f)
+{
+	if (file->data)
+		UnmapViewOfFile(file->data);
+	if (f->mapping)
+		CloseHandle(f->mapping);
+
+	file->data = 0;
+	f->mapping = 0;
+}
+
+bool
+sys_map_file(const char *path, mapped_file *file)
+{
+	HANDLE h = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+
+	win32_file *f = allocate<win32_file>(1, ALLOCATE_ZERO);
+	f->file = h;
+
+	if (!map_view(file, f)) {
+		unmap_view(file, f);
+		CloseHandle(h);
+		sys_deallocate(f, sizeof(win32_file), alignof(win32_file));
+		return false;
+	}
+
+	char dir[MAX_PATH];
+	char *end = copy_string(dir, dir + sizeof(dir), path);
+	while (end != dir && end[-1] != '\\' && end[-1] != '/')
+		--end;
+	copy_string(end, dir + sizeof(dir), end == dir ? "." : "");
+
+	// without a notification the size is checked on every update.
+	f->notify = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (f->notify == INVALID_HANDLE_VALUE)
+		f->notify = 0;
+
+	file->sys = f;
+	return true;
+}
+
+bool
+sys_update_file(mapped_file *file)
+{
+	win32_file *f = (win32_file *)file->sys;
+
+	if (f->notify) {
+		if (WaitForSingleObject(f->notify, 0) != WAIT_OBJECT_0)
+			return false;
+		FindNextChangeNotification(f->notify);
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(f->file, &size) || (u64)size.QuadPart == file->size)
+		return false;
+
+	unmap_view(file, f);
+	bool ok = map_view(file, f);
+	assert(ok);
+	return true;
+}
+
+void
+sys_unmap_file(mapped_file *file)
+{
+	win32_file *f = (win32_file *)file->sys;
+
+	unmap_view(file, f);
+	CloseHandle(f->file);
+	if (f->notify)
+		FindCloseChangeNotification(f->notify);
+	sys_deallocate(f, sizeof(win32_file), alignof(win32_file));
+
+	*file = {};
+}
+
+struct profiler *
+sys_profiler(void)
+{
+#if PROFILER
+	return global_profiler;
+#else
+	return 0;
+#endif
+}
+
+internal void
+start_profiler(void)
+{
+#if PROFILER
+	global_profiler = allocate<profiler>(1, ALLOCATE_ZERO);
+	global_profiler->frequency = sys_tick_frequency();
+#endif
+}
+
+////////
+//
+// frame pacing. between frames the main loop sleeps on a high resolution
+// waitable timer, the reload event and the message queue, so a window
+// nothing happens in costs no cpu.
+//
+
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION	0x00000002
+#endif
+
+#define DEFAULT_FPS	60
+
+static frame_pacing global_pacing;
+static HANDLE global_timer;
+
+struct frame_pacing *
+sys_frame_pacing(void)
+{
+	return &global_pacing;
+}
+
+internal void
+start_pacing(i32 mode, i32 fps)
+{
+	global_pacing.mode = mode;
+	global_pacing.target_fps = fps;
+	global_pacing.next_frame = ~0ull;
+
+	// high resolution timers need windows 10 1803. older timers wake on
+	// the next scheduler tick.
+	global_timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!global_timer)
+		global_timer = CreateWaitableTimerExW(0, 0, 0, TIMER_ALL_ACCESS);
+	assert(global_timer);
+}
+
+// sleeps until the sys_ticks time due, until new code is staged or until a
+// message arrives. due may be ~0.
+internal void
+wait_until(u64 due)
+{
+	profile_zone("wait");
+
+	u64 now = sys_ticks();
+	if (due > now) {
+		HANDLE handles[2] = { global_reload_event, global_timer };
+		DWORD count = 1;
+		if (due != ~0ull) {
+			// a negative due time is relative, in 100 ns units.
+			LARGE_INTEGER t;
+			t.QuadPart = -(i64)((due - now) * 10000000 / sys_tick_frequency());
+			SetWaitableTimer(global_timer, &t, 0, 0, 0, FALSE);
+			count = 2;
+		}
+		MsgWaitForMultipleObjectsEx(count, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+	}
+
+	++global_pacing.wakeups;
+}
+
+internal inline void
+WinInput(void)
+{
+	if (!global_input)
+		global_input = sys_ticks();
+	global_dirty = true;
+}
+
+////////
+//
+// work queue. a fixed ring of entries filled by the render thread and
+// drained by the worker threads, which sleep on a semaphore while it is
+// empty.
+
+#define WORK_QUEUE_SIZE	1024
+
+struct work_entry
+{
+	work_proc *proc;
+	void *data;
+};
+
+struct work_queue
+{
+	volatile LONG completion_goal;
+	volatile LONG completion_count;
+
+	volatile LONG next_write;
+	volatile LONG next_read;
+
+	HANDLE semaphore;
+	i32 worker_count;
+	u32 pad;
+
+	work_entry entries[WORK_QUEUE_SIZE];
+};
+
+static work_queue global_work;
+
+// holds the worker index + 1 of worker threads, and 0 elsewhere.
+static DWORD global_thread_slot;
+
+i32
+sys_worker_count(void)
+{
+	return global_work.worker_count;
+}
+
+// must only be called from the render thread.
+void
+sys_add_work(work_proc *proc, void *data)
+{
+	work_queue& q = global_work;
+
+	LONG next = (q.next_write + 1) % WORK_QUEUE_SIZE;
+	assert(next != q.next_read);
+
+	work_entry& e = q.entries[q.next_write];
+	e.proc = proc;
+	e.data = data;
+	++q.completion_goal;
+
+	_WriteBarrier();
+	q.next_write = next;
+	ReleaseSemaphore(q.semaphore, 1, 0);
+}
+
+// returns false if there was nothing to do.
+internal bool
+do_next_work(i32 worker)
+{
+	work_queue& q = global_work;
+
+	LONG read = q.next_read;
+	if (read == q.next_write)
+		return false;
+
+	LONG next = (read + 1) % WORK_QUEUE_SIZE;
+	if (InterlockedCompareExchange(&q.next_read, next, read) == read) {
+		work_entry e = q.entries[read];
+		e.proc(worker, e.data);
+		InterlockedIncrement(&q.completion_count);
+	}
+
+	return true;
+}
+
+i32
+sys_thread_index(void)
+{
+	i32 worker = (i32)(uintptr_t)TlsGetValue(global_thread_slot);
+	return worker ? worker - 1 : global_work.worker_count;
+}
+
+// runs queued work on the calling thread until all of it is done.
+void
+sys_complete_work(void)
+{
+	work_queue& q = global_work;
+
+	while (q.completion_goal != q.completion_count)
+		do_next_work(q.worker_count);
+
+	q.completion_goal = 0;
+	q.completion_count = 0;
+}
+
+// gives the rest of the time slice to another thread that is ready to run.
+void
+sys_yield(void)
+{
+	SwitchToThread();
+}
+
+internal DWORD WINAPI
+WorkerThreadProc(LPVOID param)
+{
+	i32 worker = (i32)(uintptr_t)param;
+	TlsSetValue(global_thread_slot, (LPVOID)(uintptr_t)(worker + 1));
+
+	for (;;) {
+		if (!do_next_work(worker))
+			WaitForSingleObjectEx(global_work.semaphore, INFINITE, FALSE);
+	}
+}
+
+internal void
+start_workers(void)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+
+	i32 count = min((i32)si.dwNumberOfProcessors - 1, MAX_WORKER_THREADS);
+	global_work.worker_count = max(count, 0);
+	global_work.semaphore = CreateSemaphoreEx(0, 0, WORK_QUEUE_SIZE, 0, 0, SEMAPHORE_ALL_ACCESS);
+	global_thread_slot = TlsAlloc();
+
+	for (i32 i = 0; i < global_work.worker_count; ++i) {
+		HANDLE thread = CreateThread(0, 0, WorkerThreadProc, (LPVOID)(uintptr_t)i, 0, 0);
+		CloseHandle(thread);
+	}
+}
+
 ////////
 
 internal inline const char *
@@ -195,65 +711,234 @@ make_filename(DWORD n, const wchar_t *path, const wchar_t *name)
 	return result;
 }
 
+internal inline bool
+name_match(const wchar_t *s, DWORD n, const wchar_t *name)
+{
+	while (n && *name && *s == *name) {
+		++s;
+		++name;
+		--n;
+	}
+	return n == 0 && *name == 0;
+}
+
+// copies the module to a staging name and loads it from there, so the
+// build can replace code.dll again while it runs. returns 0 if it does not
+// load or misses a function.
+internal HMODULE
+stage_code(const wchar_t *path)
+{
+	// a virus scanner may still hold the new module for a moment.
+	BOOL copied = FALSE;
+	for (i32 tries = 0; !copied && tries < 50; ++tries) {
+		copied = CopyFile(global_codename, path, FALSE);
+		if (!copied)
+			Sleep(10);
+	}
+	if (!copied)
+		return 0;
+
+	HMODULE code = LoadLibraryEx(path, 0, 0);
+	if (!code)
+		return 0;
+
+	bool complete = true;
+	#define X(ret, name, ...)	\
+		complete = complete && GetProcAddress(code, #name) != 0;
+
+		CODE_FUNCTIONS
+		OPENGL_FUNCTIONS
+		SYSTEM_FUNCTIONS
+	#undef X
+
+	if (!complete) {
+		FreeLibrary(code);
+		return 0;
+	}
+
+	return code;
+}
+
 internal void
-reload_code(void)
+publish_code(HMODULE code, u64 written)
 {
-	WIN32_FILE_ATTRIBUTE_DATA fd;
+	global_staged_code = code;
+	global_staged_written = written;
+	atomic_store(&global_staged, 1);
+	SetEvent(global_reload_event);
+}
+
+// the build holds build.lock while it writes code.dll. once the lock is
+// gone and code.dll is newer than the module last staged, the next module
+// is staged under the other name than the one in use.
+internal DWORD WINAPI
+WatchCodeProc(LPVOID lpParameter)
+{
+	FILETIME lastwrite = *(FILETIME *)lpParameter;
+	i32 slot = 1;
+
+	HANDLE dir = CreateFile(global_codedir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0);
+	if (dir == INVALID_HANDLE_VALUE)
+		return 0;
+
+	u64 written = 0;
+	// under a page, so the stack is not probed without the crt.
+	alignas(DWORD) u8 changes[2048];
 
-	if (GetFileAttributesEx(global_codename, GetFileExInfoStandard, &fd)) {
-		if (CompareFileTime(&fd.ftLastWriteTime, &global_lastwrite) == 1) {
-			if (global_code) {
-				FreeLibrary(global_code);
-				global_code = 0;
+	for (;;) {
+		DWORD bytes = 0;
+		if (!ReadDirectoryChangesW(dir, changes, sizeof(changes), FALSE,
+					   FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, &bytes, 0, 0))
+			return 0;
+
+		// no bytes means the changes did not fit and were dropped.
+		u64 now = sys_ticks();
+		bool relevant = bytes == 0;
+		for (u8 *p = changes; bytes;) {
+			FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)p;
+			DWORD n = info->FileNameLength / sizeof(wchar_t);
+			if (name_match(info->FileName, n, L"code.dll")) {
+				relevant = true;
+				if (!written)
+					written = now;
 			}
-			while (GetFileAttributes(global_lockname) != INVALID_FILE_ATTRIBUTES)
-				Sleep(0);
-			BOOL ok = CopyFile(global_codename, global_loadedname, FALSE);
-			assert(ok);
-
-			ok = GetFileAttributesEx(global_codename, GetFileExInfoStandard, &fd);
-			assert(ok);
-
-			global_code = LoadLibraryEx(global_loadedname, 0, 0);
-			assert(global_code);
-			global_lastwrite = fd.ftLastWriteTime;
-
-			#define X(ret, name, ...)	\
-				name = (ret (*)(__VA_ARGS__))(void*)GetProcAddress(global_code, #name);	\
-				assert(name);
-
-				CODE_FUNCTIONS
-			#undef X
-
-			#define X(ret, name, ...)		\
-				do {				\
-					ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))(void*)GetProcAddress(global_code, #name);	\
-					assert(fn);		\
-					*fn = (ret (*)(__VA_ARGS__))(void*)wglGetProcAddress(#name);	\
-					if (!*fn) {		\
-						*fn = (ret (*)(__VA_ARGS__))(void*)GetProcAddress(GetModuleHandleA("opengl32.dll"), #name);	\
-						assert(*fn);	\
-					}			\
-				} while (0);
-
-				OPENGL_FUNCTIONS
-			#undef X
-
-			#define X(ret, name, ...)		\
-				do {				\
-					ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))GetProcAddress(global_code, #name);	\
-					assert(fn);		\
-					*fn = name;	\
-				} while (0);
-
-				SYSTEM_FUNCTIONS
-			#undef X
-
-			global_userdata = reload(global_userdata);
+			if (name_match(info->FileName, n, L"build.lock"))
+				relevant = true;
+
+			if (!info->NextEntryOffset)
+				break;
+			p += info->NextEntryOffset;
+		}
+
+		WIN32_FILE_ATTRIBUTE_DATA fd;
+		if (!relevant || GetFileAttributes(global_lockname) != INVALID_FILE_ATTRIBUTES ||
+		    !GetFileAttributesEx(global_codename, GetFileExInfoStandard, &fd) ||
+		    CompareFileTime(&fd.ftLastWriteTime, &lastwrite) != 1)
+			continue;
+
+		// the main loop takes a module within a frame of being woken.
+		while (atomic_load(&global_staged))
+			Sleep(1);
+
+		u64 start = sys_ticks();
+		HMODULE code = stage_code(global_stagednames[slot]);
+		lastwrite = fd.ftLastWriteTime;
+		if (!code) {
+			++global_reload.rejected;
+			written = 0;
+			continue;
 		}
+
+		global_reload.stage_ticks = sys_ticks() - start;
+		publish_code(code, written ? written : start);
+		slot ^= 1;
+		written = 0;
 	}
 }
 
+// swaps in the module the watcher staged, if there is one. the main loop
+// calls it between frames; true means the code changed.
+internal bool
+swap_code(void)
+{
+	if (!atomic_load(&global_staged))
+		return false;
+
+	profile_function();
+
+	u64 start = sys_ticks();
+
+	// queued work may point into the old code.
+	sys_complete_work();
+
+	if (global_code) {
+		// the old code hands over its state in a form the new code
+		// understands.
+		u64 (*layout)(void) = (u64 (*)(void))(void*)GetProcAddress(global_staged_code, "state_layout");
+		global_userdata = migrate(global_userdata, layout());
+
+		FreeLibrary(global_code);
+		global_code = 0;
+#if PROFILER
+		// the events name zones in the unloaded code.
+		profile_reset(global_profiler);
+#endif
+	}
+
+	global_code = global_staged_code;
+	global_swapped_written = global_staged_written;
+	atomic_store(&global_staged, 0);
+
+	#define X(ret, name, ...)	\
+		name = (ret (*)(__VA_ARGS__))(void*)GetProcAddress(global_code, #name);
+
+		CODE_FUNCTIONS
+	#undef X
+
+	#define X(ret, name, ...)		\
+		do {				\
+			ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))(void*)GetProcAddress(global_code, #name);	\
+			*fn = (ret (*)(__VA_ARGS__))(void*)wglGetProcAddress(#name);	\
+			if (!*fn) {		\
+				*fn = (ret (*)(__VA_ARGS__))(void*)GetProcAddress(GetModuleHandleA("opengl32.dll"), #name);	\
+				assert(*fn);	\
+			}			\
+		} while (0);
+
+		OPENGL_FUNCTIONS
+	#undef X
+
+	#define X(ret, name, ...)		\
+		do {				\
+			ret (**fn)(__VA_ARGS__) = (ret (**)(__VA_ARGS__))GetProcAddress(global_code, #name);	\
+			*fn = name;	\
+		} while (0);
+
+		SYSTEM_FUNCTIONS
+	#undef X
+
+	bool first = !global_userdata;
+	global_userdata = reload(global_userdata);
+	if (first && global_open_path[0])
+		open_file(global_userdata, global_open_path);
+
+	++global_reload.count;
+	global_reload.swap_ticks = sys_ticks() - start;
+	return true;
+}
+
+code_reload *
+sys_code_reload(void)
+{
+	return &global_reload;
+}
+
+// loads the code for the first time and starts watching for new builds.
+internal void
+load_code(void)
+{
+	// a build in progress finishes first.
+	while (GetFileAttributes(global_lockname) != INVALID_FILE_ATTRIBUTES)
+		Sleep(10);
+
+	u64 start = sys_ticks();
+	WIN32_FILE_ATTRIBUTE_DATA fd;
+	BOOL ok = GetFileAttributesEx(global_codename, GetFileExInfoStandard, &fd);
+	assert(ok);
+	HMODULE code = stage_code(global_stagednames[0]);
+	assert(code);
+
+	static FILETIME lastwrite;
+	lastwrite = fd.ftLastWriteTime;
+	global_reload.stage_ticks = sys_ticks() - start;
+	publish_code(code, start);
+	swap_code();
+
+	HANDLE thread = CreateThread(0, 0, WatchCodeProc, &lastwrite, 0, 0);
+	CloseHandle(thread);
+}
+
 internal void
 WinRender(HWND hwnd, HDC dc)
 {
@@ -262,10 +947,25 @@ WinRender(HWND hwnd, HDC dc)
 	i32 w = r.right - r.left;
 	i32 h = r.bottom - r.top;
 
+	global_pacing.next_frame = ~0ull;
 	render(global_userdata, w, h);
 
-	BOOL ok = SwapBuffers(dc);
-	assert(ok);
+	{
+		profile_zone("SwapBuffers");
+		BOOL ok = SwapBuffers(dc);
+		assert(ok);
+	}
+
+	u64 presented = sys_ticks();
+	frame_presented(global_pacing, global_input, presented);
+	global_input = 0;
+	global_dirty = false;
+
+	// the first frame rendered with new code ends the reload.
+	if (global_swapped_written) {
+		global_reload.latency = presented - global_swapped_written;
+		global_swapped_written = 0;
+	}
 }
 
 internal inline u32
@@ -287,6 +987,7 @@ WinMouse(HWND hwnd, WPARAM wParam, LPARAM lParam)
 	i32 x = (i16)(lParam & 0xFFFF);
 	i32 y = h - (i16)((lParam >> 16) & 0xFFFF) - 1;
 
+	WinInput();
 	mouse(global_userdata, x, y, 0, WinMouseButtons(wParam));
 }
 
@@ -303,6 +1004,10 @@ WindowProcMain(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			EndPaint(hwnd, &ps);
 		} break;
 
+		case WM_SIZE: {
+			global_dirty = true;
+		} break;
+
 		case WM_DESTROY: {
 			PostQuitMessage(0);
 		} break;
@@ -348,11 +1053,13 @@ WindowProcMain(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			GetClientRect(hwnd, &r);
 			p.y = (r.bottom - r.top) - p.y - 1;
 
+			WinInput();
 			mouse(global_userdata, p.x, p.y, dz, WinMouseButtons(wParam));
 		} break;
 
 		case WM_CHAR: {
 			u32 codepoint = (u32)wParam;
+			WinInput();
 			keyboard(global_userdata, codepoint);
 		} break;
 
@@ -362,6 +1069,7 @@ WindowProcMain(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			}
 			else {
 				u32 codepoint = (u32)wParam;
+				WinInput();
 				keyboard(global_userdata, codepoint);
 			}
 		} break;
@@ -384,6 +1092,39 @@ void WinEntry(void)
 
     	SetProcessDPIAware();
 
+	// --fps n renders n frames a second rather than on demand. the first
+	// argument after it, without quotes, is a file to open.
+	i32 fps = 0;
+	{
+		const char *s = GetCommandLineA();
+		bool quoted = false;
+		for (; *s && (quoted || (*s != ' ' && *s != '\t')); ++s)
+			if (*s == '"')
+				quoted = !quoted;
+		while (*s == ' ' || *s == '\t')
+			++s;
+
+		if (token_match(s, token_end(s), "--fps")) {
+			s = skip_space(token_end(s));
+			while (*s >= '0' && *s <= '9')
+				fps = fps * 10 + (*s++ - '0');
+			while (*s == ' ' || *s == '\t')
+				++s;
+		}
+
+		char *p = global_open_path;
+		char *end = global_open_path + sizeof(global_open_path) - 1;
+		for (; *s && p != end; ++s)
+			if (*s != '"')
+				*p++ = *s;
+		while (p != global_open_path && (p[-1] == ' ' || p[-1] == '\t'))
+			--p;
+		*p = 0;
+	}
+
+    	start_profiler();
+    	start_workers();
+
     	////////
     	//
     	// init hot code reloading.
@@ -401,9 +1142,12 @@ void WinEntry(void)
     		while (n && exename[n - 1] != L'\\')
     			--n;
 
+    		global_codedir = make_filename(n, exename, L".");
     		global_codename = make_filename(n, exename, L"code.dll");
-    		global_loadedname = make_filename(n, exename, L"loaded.dll");
+    		global_stagednames[0] = make_filename(n, exename, L"loaded.dll");
+    		global_stagednames[1] = make_filename(n, exename, L"loaded2.dll");
     		global_lockname = make_filename(n, exename, L"build.lock");
+    		global_reload_event = CreateEvent(0, FALSE, FALSE, 0);
 
     		sys_deallocate(exename, m * sizeof(wchar_t), alignof(wchar_t));
     	}
@@ -515,7 +1259,8 @@ void WinEntry(void)
 	wglMakeCurrent(dc, rc);
 
 	wglSwapIntervalEXT(1);
-	reload_code();
+	start_pacing(fps ? PACING_FIXED : PACING_ON_DEMAND, fps ? fps : DEFAULT_FPS);
+	load_code();
 
 	////////
 	//
@@ -523,18 +1268,33 @@ void WinEntry(void)
 	//
 	ShowWindow(hwnd, SW_SHOWNORMAL);
 
+	u64 frequency = sys_tick_frequency();
+	u64 last_frame = 0;
+
 	MSG msg;
 	for (;;) {
-		reload_code();
-
-		while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
-			if (msg.message == WM_QUIT) {
-				ExitProcess(0);
+		if (swap_code())
+			global_dirty = true;
+
+		{
+			profile_zone("PeekMessage");
+			while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+				if (msg.message == WM_QUIT) {
+					ExitProcess(0);
+				}
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
 			}
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
 		}
 
+		u64 due = next_frame_due(global_pacing, last_frame, frequency, global_dirty);
+		u64 now = sys_ticks();
+		if (due > now) {
+			wait_until(due);
+			continue;
+		}
+		last_frame = frame_start_time(global_pacing, due, now, frequency);
+
 		WinRender(hwnd, dc);
 	}
 }
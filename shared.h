@@ -5,21 +5,118 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef int8_t i8;
+typedef int16_t i16;
+typedef int32_t i32;
+typedef int64_t i64;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef float f32;
+
+#if defined(_MSC_VER)
+#define debug_break() __debugbreak()
+#else
+#define debug_break() __builtin_trap()
+#endif
+
 #define assert(x)		\
 do {				\
 	if (!(x)) {		\
-		__debugbreak();	\
+		debug_break();	\
 	}			\
 } while (0)
 
 #define internal static
 #define unused(x) ((void)(x))
 
-template<typename T> inline
-T *allocate(size_t n)
+#if defined(_WIN32)
+#define API_EXPORT extern "C" __declspec(dllexport)
+#else
+#define API_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+struct font;
+struct profiler;
+struct frame_pacing;
+struct code_reload;
+
+// a read only view of a whole file. sys_update_file picks up a change of
+// size, which may map the file again at another address, and returns true
+// then. the platform keeps its handles in sys.
+struct mapped_file
 {
-	return static_cast<T*>(sys_allocate(n * sizeof(T), alignof(T)));
-}
+	const u8 *data;
+	u64 size;
+	void *sys;
+};
+
+// zero the memory returned. without it the contents are undefined.
+#define ALLOCATE_ZERO	0x1
+
+// upper limit for the number of worker threads of the platform.
+#define MAX_WORKER_THREADS	15
+
+// work queued with sys_add_work runs on one of the worker threads, or on
+// the calling thread while it waits in sys_complete_work. worker is the
+// index of the thread in [0, sys_worker_count()], where the last index is
+// the thread waiting in sys_complete_work.
+typedef void work_proc(i32 worker, void *data);
+
+// sys_allocate takes the ALLOCATE_ flags below. sys_reallocate keeps the
+// contents and grows the block in place when the heap can. sys_reserve reserves
+// address space only, which sys_commit backs with zeroed memory page by
+// page.
+// sys_find_font_file finds the file of an installed font family, and the
+// index of the font in it when the file is a collection.
+// sys_thread_index numbers the calling thread like work_proc does.
+// sys_ticks is a monotonic clock that advances sys_tick_frequency ticks
+// per second. sys_profiler is 0 unless the platform is built with PROFILER.
+// sys_frame_pacing and sys_code_reload are owned by the platform and live
+// as long as it.
+
+#define SYSTEM_FUNCTIONS	\
+	X(void *, sys_allocate, size_t n, size_t alignment, u32 flags)	\
+	X(void, sys_deallocate, void *p, size_t n, size_t alignment)	\
+	X(void *, sys_reallocate, void *p, size_t n, size_t new_n, size_t alignment)	\
+	X(void *, sys_reserve, size_t n)	\
+	X(bool, sys_commit, void *p, size_t n)	\
+	X(void, sys_release, void *p, size_t n)	\
+	X(struct font *, sys_create_font, const wchar_t *name, i32 pixel_height)	\
+	X(bool, sys_find_font_file, const wchar_t *name, char *path, size_t size, i32 *index)	\
+	X(i32, sys_render_glyph, struct font *font, u32 codepoint)	\
+	X(i32, sys_worker_count, void)	\
+	X(void, sys_add_work, work_proc *proc, void *data)	\
+	X(void, sys_complete_work, void)	\
+	X(void, sys_yield, void)	\
+	X(i32, sys_thread_index, void)	\
+	X(u64, sys_ticks, void)	\
+	X(u64, sys_tick_frequency, void)	\
+	X(bool, sys_write_file, const char *path, const void *data, size_t size, bool append)	\
+	X(struct profiler *, sys_profiler, void)	\
+	X(struct frame_pacing *, sys_frame_pacing, void)	\
+	X(struct code_reload *, sys_code_reload, void)	\
+	X(bool, sys_map_file, const char *path, struct mapped_file *file)	\
+	X(bool, sys_update_file, struct mapped_file *file)	\
+	X(void, sys_unmap_file, struct mapped_file *file)	\
+	/* end */
+
+// the code module reaches the system functions through pointers that the
+// platform fills in after loading it.
+#if defined(CODE_MODULE)
+#define X(ret, name, ...) API_EXPORT ret (*name)(__VA_ARGS__);
+#else
+#define X(ret, name, ...) ret name(__VA_ARGS__);
+#endif
+SYSTEM_FUNCTIONS
+#undef X
 
 ////////
 //
@@ -28,6 +125,41 @@ T *allocate(size_t n)
 template<typename T> inline T min(T a, T b) { return b < a ? b : a; }
 template<typename T> inline T max(T a, T b) { return a > b ? a : b; }
 
+// index of the lowest and highest set bit. x must not be zero.
+inline i32
+lowest_set_bit(u32 x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (i32)i;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+inline i32
+population_count(u32 x)
+{
+#if defined(_MSC_VER)
+	return (i32)__popcnt(x);
+#else
+	return __builtin_popcount(x);
+#endif
+}
+
+inline i32
+highest_set_bit(u32 x)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse(&i, x);
+	return (i32)i;
+#else
+	return 31 - __builtin_clz(x);
+#endif
+}
+
 template<typename I, typename S>
 I copy_string(I f, I l, S sz)
 {
@@ -41,6 +173,15 @@ I copy_string(I f, I l, S sz)
 	return f;
 }
 
+template<typename S> inline
+size_t string_length(const S *sz)
+{
+	size_t n = 0;
+	while (sz[n])
+		++n;
+	return n;
+}
+
 template<typename N, typename O, typename I, typename F> inline
 void transform_n(N n, O dst, I src, F f)
 {
@@ -48,6 +189,24 @@ void transform_n(N n, O dst, I src, F f)
 		*dst++ = f(*src++);
 }
 
+// stable sort, for the short sequences where it beats anything fancier.
+template<typename I, typename C>
+void insertion_sort(I f, I l, C less)
+{
+	if (f == l)
+		return;
+
+	for (I i = f + 1; i != l; ++i) {
+		auto x = *i;
+		I j = i;
+		while (j != f && less(x, *(j - 1))) {
+			*j = *(j - 1);
+			--j;
+		}
+		*j = x;
+	}
+}
+
 template<typename T0, typename T1>
 struct pair
 {
@@ -71,10 +230,374 @@ I fill_n(N n, I it, const T& x)
 	return it;
 }
 
+// copies n bytes between blocks that do not overlap, in bulk.
+inline void
+copy_bytes(void *dst, const void *src, size_t n)
+{
+#if defined(_MSC_VER)
+	__movsb((unsigned char *)dst, (const unsigned char *)src, n);
+#else
+	__builtin_memcpy(dst, src, n);
+#endif
+}
+
+////////
+//
+// atomics. loads acquire, stores release and read-modify-write operations
+// are full barriers.
+
+inline u32
+atomic_load(volatile u32 *p)
+{
+#if defined(_MSC_VER)
+	u32 result = *p;
+	_ReadWriteBarrier();
+	return result;
+#else
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void
+atomic_store(volatile u32 *p, u32 x)
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+	*p = x;
+#else
+	__atomic_store_n(p, x, __ATOMIC_RELEASE);
+#endif
+}
+
+inline u64
+atomic_load(volatile u64 *p)
+{
+#if defined(_MSC_VER)
+	u64 result = *p;
+	_ReadWriteBarrier();
+	return result;
+#else
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void
+atomic_store(volatile u64 *p, u64 x)
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+	*p = x;
+#else
+	__atomic_store_n(p, x, __ATOMIC_RELEASE);
+#endif
+}
+
+inline bool
+atomic_compare_exchange(volatile u32 *p, u32 expected, u32 desired)
+{
+#if defined(_MSC_VER)
+	return (u32)_InterlockedCompareExchange((volatile long *)p, (long)desired, (long)expected) == expected;
+#else
+	return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// returns the previous value.
+inline u32
+atomic_add(volatile u32 *p, u32 x)
+{
+#if defined(_MSC_VER)
+	return (u32)_InterlockedExchangeAdd((volatile long *)p, (long)x);
+#else
+	return __atomic_fetch_add(p, x, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// goes in the loop of a thread spinning until another one stores something.
+inline void
+cpu_relax(void)
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(_M_ARM64)
+	__yield();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+////////
+//
+// memory. allocations go to the platform heap, an arena or a pool. an
+// allocator is plain data dispatched on its kind, so it stays valid when
+// the code is reloaded. a null allocator is the heap, the only one that is
+// thread safe.
+
+#define ALLOCATOR_HEAP	0
+#define ALLOCATOR_ARENA	1
+#define ALLOCATOR_POOL	2
+
+// first member of every allocator.
+struct allocator
+{
+	u32 kind;
+	u32 pad;
+};
+
+// bump allocator on a range of reserved address space, committed as it
+// grows. only the last allocation can be freed; reset frees everything
+// allocated after a given mark.
+#define ARENA_COMMIT_SIZE	(64 * 1024)
+
+struct arena
+{
+	allocator base;
+	char name[16];
+
+	u8 *memory;
+	size_t reserved;
+	size_t committed;
+	size_t used;
+	size_t high_water;
+};
+
+// fixed size blocks on a free list. blocks are carved POOL_CHUNK at a time
+// from another allocator and never given back to it.
+#define POOL_CHUNK	64
+
+struct pool
+{
+	allocator base;
+	char name[16];
+
+	allocator *from;
+	void *free_list;
+	size_t block_size;
+
+	i64 live;
+	i64 high_water;
+};
+
+internal void
+init_arena(arena& a, const char *name, size_t reserve)
+{
+	a.base.kind = ALLOCATOR_ARENA;
+	copy_string(a.name, a.name + sizeof(a.name), name);
+
+	a.reserved = (reserve + ARENA_COMMIT_SIZE - 1) / ARENA_COMMIT_SIZE * ARENA_COMMIT_SIZE;
+	a.memory = (u8 *)sys_reserve(a.reserved);
+	assert(a.memory);
+	a.committed = 0;
+	a.used = 0;
+	a.high_water = 0;
+}
+
+internal void
+release_arena(arena& a)
+{
+	sys_release(a.memory, a.reserved);
+	a.memory = 0;
+	a.reserved = 0;
+	a.committed = 0;
+	a.used = 0;
+}
+
+// frees everything allocated since a.used was mark.
+internal inline void
+reset_arena(arena& a, size_t mark = 0)
+{
+	assert(mark <= a.used);
+	a.used = mark;
+}
+
+// moves the end of the used memory, committing more as needed.
+internal void
+set_arena_end(arena& a, size_t end)
+{
+	assert(end <= a.reserved);
+
+	if (end > a.committed) {
+		size_t n = (end - a.committed + ARENA_COMMIT_SIZE - 1) / ARENA_COMMIT_SIZE * ARENA_COMMIT_SIZE;
+		bool ok = sys_commit(a.memory + a.committed, n);
+		assert(ok);
+		a.committed += n;
+	}
+
+	a.used = end;
+	a.high_water = max(a.high_water, end);
+}
+
+internal void *
+push_arena(arena& a, size_t size, size_t alignment, u32 flags)
+{
+	size_t first = ((size_t)(a.memory + a.used) + alignment - 1) / alignment * alignment - (size_t)a.memory;
+	size_t end = first + size;
+
+	// memory above the high water mark is still zero from being committed.
+	if ((flags & ALLOCATE_ZERO) && first < a.high_water)
+		fill_n(min(end, a.high_water) - first, a.memory + first, (u8)0);
+
+	set_arena_end(a, end);
+	return a.memory + first;
+}
+
+internal void
+init_pool(pool& p, const char *name, size_t block_size, allocator *from)
+{
+	p.base.kind = ALLOCATOR_POOL;
+	copy_string(p.name, p.name + sizeof(p.name), name);
+
+	p.from = from;
+	p.free_list = 0;
+	p.block_size = (max(block_size, sizeof(void *)) + 15) / 16 * 16;
+	p.live = 0;
+	p.high_water = 0;
+}
+
+internal void *allocate_memory(allocator *from, size_t size, size_t alignment, u32 flags);
+
+internal void *
+pop_pool(pool& p, size_t size, size_t alignment, u32 flags)
+{
+	assert(size <= p.block_size && alignment <= 16);
+	unused(size);
+	unused(alignment);
+
+	if (!p.free_list) {
+		u8 *chunk = (u8 *)allocate_memory(p.from, p.block_size * POOL_CHUNK, 16, 0);
+		for (i32 i = POOL_CHUNK - 1; i >= 0; --i) {
+			void **block = (void **)(chunk + (size_t)i * p.block_size);
+			*block = p.free_list;
+			p.free_list = block;
+		}
+	}
+
+	void **block = (void **)p.free_list;
+	p.free_list = *block;
+
+	++p.live;
+	p.high_water = max(p.high_water, p.live);
+
+	if (flags & ALLOCATE_ZERO)
+		fill_n(p.block_size, (u8 *)block, (u8)0);
+	return block;
+}
+
+internal inline void
+push_pool(pool& p, void *block)
+{
+	*(void **)block = p.free_list;
+	p.free_list = block;
+	--p.live;
+}
+
+internal void *
+allocate_memory(allocator *from, size_t size, size_t alignment, u32 flags)
+{
+	if (size == 0)
+		return 0;
+
+	switch (from ? from->kind : ALLOCATOR_HEAP) {
+		case ALLOCATOR_ARENA:
+			return push_arena(*(arena *)from, size, alignment, flags);
+		case ALLOCATOR_POOL:
+			return pop_pool(*(pool *)from, size, alignment, flags);
+		default:
+			return sys_allocate(size, alignment, flags);
+	}
+}
+
+internal void
+deallocate_memory(allocator *from, void *p, size_t size, size_t alignment)
+{
+	if (!p)
+		return;
+
+	switch (from ? from->kind : ALLOCATOR_HEAP) {
+		case ALLOCATOR_ARENA: {
+			arena& a = *(arena *)from;
+			if ((u8 *)p + size == a.memory + a.used)
+				a.used = (size_t)((u8 *)p - a.memory);
+		} break;
+		case ALLOCATOR_POOL: {
+			push_pool(*(pool *)from, p);
+		} break;
+		default: {
+			sys_deallocate(p, size, alignment);
+		} break;
+	}
+}
+
+// resizes a block, keeping its contents up to the smaller size. the last
+// allocation of an arena and any block of the heap may grow in place.
+internal void *
+reallocate_memory(allocator *from, void *p, size_t size, size_t new_size, size_t alignment)
+{
+	if (!p)
+		return allocate_memory(from, new_size, alignment, 0);
+
+	switch (from ? from->kind : ALLOCATOR_HEAP) {
+		case ALLOCATOR_ARENA: {
+			arena& a = *(arena *)from;
+			if ((u8 *)p + size == a.memory + a.used) {
+				set_arena_end(a, (size_t)((u8 *)p - a.memory) + new_size);
+				return p;
+			}
+
+			void *result = push_arena(a, new_size, alignment, 0);
+			copy_bytes(result, p, min(size, new_size));
+			return result;
+		}
+		case ALLOCATOR_POOL: {
+			assert(new_size <= ((pool *)from)->block_size);
+			return p;
+		}
+		default: {
+			return sys_reallocate(p, size, new_size, alignment);
+		}
+	}
+}
+
+template<typename T> inline
+T *allocate(size_t n, u32 flags = 0)
+{
+	return static_cast<T*>(sys_allocate(n * sizeof(T), alignof(T), flags));
+}
+
+template<typename T> inline
+T *allocate(allocator *from, size_t n, u32 flags = 0)
+{
+	return static_cast<T*>(allocate_memory(from, n * sizeof(T), alignof(T), flags));
+}
+
+template<typename T> inline
+void deallocate(allocator *from, T *p, size_t n)
+{
+	deallocate_memory(from, p, n * sizeof(T), alignof(T));
+}
+
+// only for types that can be moved with a bulk copy.
+template<typename T> inline
+T *reallocate(allocator *from, T *p, size_t n, size_t new_n)
+{
+	return static_cast<T*>(reallocate_memory(from, p, n * sizeof(T), new_n * sizeof(T), alignof(T)));
+}
+
 ////////
 //
 // generic data structures
 
+// arrays grow by ARRAY_GROWTH percent of their limit, and to at least
+// ARRAY_MIN_BYTES worth of items. both can be defined before this file is
+// included.
+#if !defined(ARRAY_GROWTH)
+#define ARRAY_GROWTH	100
+#endif
+
+#if !defined(ARRAY_MIN_BYTES)
+#define ARRAY_MIN_BYTES	64
+#endif
+
 template<typename N, typename T>
 struct array
 {
@@ -82,6 +605,9 @@ struct array
 	N count;
 	T *data;
 
+	// where data comes from. 0 is the heap.
+	allocator *from;
+
 	friend T *begin(array& a) { return a.data; }
 	friend T *end(array& a) { return a.data + a.count; }
 
@@ -90,20 +616,29 @@ struct array
 		if (limit <= a.limit)
 			return;
 
-		T *data = allocate<T>((size_t)limit);
-		copy_n(a.count, data, a.data);
-		sys_deallocate(a.data, (size_t)a.limit * sizeof(T), alignof(T));
+		if constexpr (__is_trivially_copyable(T)) {
+			// the items move with a bulk copy, or not at all if the
+			// allocator can grow the block in place.
+			a.data = reallocate<T>(a.from, a.data, (size_t)a.limit, (size_t)limit);
+		}
+		else {
+			T *data = allocate<T>(a.from, (size_t)limit);
+			copy_n(a.count, data, a.data);
+			deallocate(a.from, a.data, (size_t)a.limit);
+			a.data = data;
+		}
 
 		a.limit = limit;
-		a.data = data;
 	}
 
-	// allocateds n items at the end of the array. if there is not enough
-	// room it reallocates more memory using a growth factor of 2.
+	// allocates n items at the end of the array, growing it if there is
+	// not enough room.
 	friend T *allocate_n(array& a, N n)
 	{
 		if (N m = a.count + n; m > a.limit) {
-			reserve(a, max(a.limit * 2, m));
+			N grown = a.limit + (N)((i64)a.limit * ARRAY_GROWTH / 100);
+			N least = (N)max(ARRAY_MIN_BYTES / sizeof(T), (size_t)1);
+			reserve(a, max(max(grown, least), m));
 		}
 
 		T *result = a.data + a.count;
@@ -114,20 +649,523 @@ struct array
 	friend void clear(array& a) { a.count = 0; }
 
 	friend bool is_empty(const array& a) { return a.count == 0; }
+
+	// frees the items. the array can be used again.
+	friend void release(array& a)
+	{
+		deallocate(a.from, a.data, (size_t)a.limit);
+		a.limit = 0;
+		a.count = 0;
+		a.data = 0;
+	}
+};
+
+// bounded lock-free queue for any number of producers and consumers, after
+// Dmitry Vyukov. every slot carries a sequence number that tells whether
+// it is ready to be written or read at a given position. N must be a power
+// of two and init must be called before use.
+template<typename T, u32 N>
+struct mpmc_queue
+{
+	volatile u32 sequence[N];
+	T data[N];
+
+	volatile u32 write;
+	volatile u32 read;
+
+	friend void init(mpmc_queue& q)
+	{
+		for (u32 i = 0; i < N; ++i)
+			q.sequence[i] = i;
+		q.write = 0;
+		q.read = 0;
+	}
+
+	// returns false if the queue is full.
+	friend bool push(mpmc_queue& q, T x)
+	{
+		u32 pos = atomic_load(&q.write);
+		for (;;) {
+			u32 i = pos & (N - 1);
+			i32 diff = (i32)(atomic_load(&q.sequence[i]) - pos);
+			if (diff == 0) {
+				if (atomic_compare_exchange(&q.write, pos, pos + 1)) {
+					q.data[i] = x;
+					atomic_store(&q.sequence[i], pos + 1);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			pos = atomic_load(&q.write);
+		}
+	}
+
+	// returns false if the queue is empty.
+	friend bool pop(mpmc_queue& q, T *x)
+	{
+		u32 pos = atomic_load(&q.read);
+		for (;;) {
+			u32 i = pos & (N - 1);
+			i32 diff = (i32)(atomic_load(&q.sequence[i]) - (pos + 1));
+			if (diff == 0) {
+				if (atomic_compare_exchange(&q.read, pos, pos + 1)) {
+					*x = q.data[i];
+					atomic_store(&q.sequence[i], pos + N);
+					return true;
+				}
+			}
+			else if (diff < 0) {
+				return false;
+			}
+			pos = atomic_load(&q.read);
+		}
+	}
+};
+
+// open addressing hash map from u32 keys to N values using linear
+// probing. the number of slots is always a power of two and the table is
+// kept at most half full. empty_key (0xFFFFFFFF) marks free slots, so it
+// can not be a key itself: find and remove never find it and insert
+// refuses it.
+template<typename N>
+struct index_map
+{
+	static constexpr u32 empty_key = 0xFFFFFFFF;
+
+	N limit;
+	N count;
+	u32 *keys;
+	N *values;
+
+	static u32 hash(u32 key)
+	{
+		key *= 0x9E3779B1;
+		return key ^ (key >> 15);
+	}
+
+	friend N *find(index_map& m, u32 key)
+	{
+		if (m.limit == 0 || key == empty_key)
+			return 0;
+
+		u32 mask = (u32)m.limit - 1;
+		for (u32 i = hash(key) & mask;; i = (i + 1) & mask) {
+			if (m.keys[i] == key)
+				return m.values + i;
+			if (m.keys[i] == empty_key)
+				return 0;
+		}
+	}
+
+	friend bool insert(index_map& m, u32 key, N value)
+	{
+		if (key == empty_key)
+			return false;
+
+		if (2 * (m.count + 1) > m.limit) {
+			N limit = max(m.limit * 2, (N)64);
+			u32 *keys = allocate<u32>((size_t)limit);
+			N *values = allocate<N>((size_t)limit);
+			fill_n(limit, keys, empty_key);
+
+			u32 mask = (u32)limit - 1;
+			for (N j = 0; j < m.limit; ++j) {
+				if (m.keys[j] == empty_key)
+					continue;
+
+				u32 i = hash(m.keys[j]) & mask;
+				while (keys[i] != empty_key)
+					i = (i + 1) & mask;
+				keys[i] = m.keys[j];
+				values[i] = m.values[j];
+			}
+
+			sys_deallocate(m.keys, (size_t)m.limit * sizeof(u32), alignof(u32));
+			sys_deallocate(m.values, (size_t)m.limit * sizeof(N), alignof(N));
+
+			m.limit = limit;
+			m.keys = keys;
+			m.values = values;
+		}
+
+		u32 mask = (u32)m.limit - 1;
+		u32 i = hash(key) & mask;
+		while (m.keys[i] != empty_key && m.keys[i] != key)
+			i = (i + 1) & mask;
+
+		if (m.keys[i] == empty_key) {
+			m.keys[i] = key;
+			++m.count;
+		}
+		m.values[i] = value;
+		return true;
+	}
+
+	// later keys of the same probe run are shifted back into the hole, so
+	// no tombstones are needed.
+	friend bool remove(index_map& m, u32 key)
+	{
+		if (m.limit == 0 || key == empty_key)
+			return false;
+
+		u32 mask = (u32)m.limit - 1;
+		u32 i = hash(key) & mask;
+		for (; m.keys[i] != key; i = (i + 1) & mask)
+			if (m.keys[i] == empty_key)
+				return false;
+
+		for (u32 j = (i + 1) & mask; m.keys[j] != empty_key; j = (j + 1) & mask) {
+			// the key at j may move to i if i is between its home slot and j.
+			u32 home = hash(m.keys[j]) & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				m.keys[i] = m.keys[j];
+				m.values[i] = m.values[j];
+				i = j;
+			}
+		}
+
+		m.keys[i] = empty_key;
+		--m.count;
+		return true;
+	}
+
+	friend void release(index_map& m)
+	{
+		if (m.limit) {
+			sys_deallocate(m.keys, (size_t)m.limit * sizeof(u32), alignof(u32));
+			sys_deallocate(m.values, (size_t)m.limit * sizeof(N), alignof(N));
+		}
+		m = {};
+	}
 };
 
 ////////
+//
+// profiler. zones record begin and end timestamps into a ring of events
+// per thread. the rings belong to the platform, so zones in the platform
+// and in the code module end up in the same place. with PROFILER 0 the
+// zone macros compile to nothing.
 
-typedef int8_t i8;
-typedef int16_t i16;
-typedef int32_t i32;
-typedef uint8_t u8;
-typedef uint32_t u32;
-typedef uint64_t u64;
-typedef float f32;
+#if !defined(PROFILER)
+#define PROFILER 0
+#endif
+
+#if PROFILER
+
+// events per thread. must be a power of two.
+#define PROFILE_RING_SIZE	16384
+
+struct profile_event
+{
+	const char *name;	// 0 ends the innermost open zone.
+	u64 ticks;
+};
+
+struct profile_ring
+{
+	volatile u32 write;
+
+	// events before start are gone, e.g. because they name zones of code
+	// that has been unloaded.
+	u32 start;
+
+	// keeps the rings that other threads write on their own cache lines.
+	u32 pad[14];
+
+	profile_event events[PROFILE_RING_SIZE];
+};
+
+struct profiler
+{
+	u64 frequency;
+	u64 pad[7];
+
+	profile_ring rings[MAX_WORKER_THREADS + 1];
+};
+
+internal profiler *global_profiler;
+
+internal inline i32
+profile_begin(const char *name)
+{
+	i32 thread = sys_thread_index();
+	profile_ring& r = global_profiler->rings[thread];
+
+	u32 w = r.write;
+	profile_event& e = r.events[w & (PROFILE_RING_SIZE - 1)];
+	e.name = name;
+	e.ticks = sys_ticks();
+	atomic_store(&r.write, w + 1);
+
+	return thread;
+}
+
+internal inline void
+profile_end(i32 thread)
+{
+	profile_ring& r = global_profiler->rings[thread];
+
+	u32 w = r.write;
+	profile_event& e = r.events[w & (PROFILE_RING_SIZE - 1)];
+	e.name = 0;
+	e.ticks = sys_ticks();
+	atomic_store(&r.write, w + 1);
+}
+
+struct profile_scope
+{
+	i32 thread;
+
+	profile_scope(const char *name) : thread(profile_begin(name)) {}
+	~profile_scope() { profile_end(thread); }
+};
+
+#define profile_concat_(a, b) a##b
+#define profile_concat(a, b) profile_concat_(a, b)
+
+// times the rest of the enclosing scope. name must be a string that lives
+// as long as the module that records it.
+#define profile_zone(name) profile_scope profile_concat(profile_scope_, __LINE__)(name)
+#define profile_function() profile_zone(__FUNCTION__)
+
+// the range of events of a ring that can still be read.
+internal inline u32
+profile_first_event(const profile_ring& r, u32 write)
+{
+	u32 first = write - r.start > PROFILE_RING_SIZE ? write - PROFILE_RING_SIZE : r.start;
+	return first;
+}
+
+// forgets every event recorded so far. no thread may record meanwhile.
+internal void
+profile_reset(profiler *p)
+{
+	for (profile_ring& r : p->rings)
+		r.start = r.write;
+}
+
+struct profile_writer
+{
+	const char *path;
+	char *at;
+	bool ok;
+	bool append;
+	u8 pad[6];
+	char buf[8192];
+};
+
+internal void
+profile_flush(profile_writer& w)
+{
+	if (w.ok)
+		w.ok = sys_write_file(w.path, w.buf, (size_t)(w.at - w.buf), w.append);
+	w.append = true;
+	w.at = w.buf;
+}
+
+internal void
+profile_write(profile_writer& w, const char *s, bool escape = false)
+{
+	for (; *s; ++s) {
+		if (escape && (*s == '"' || *s == '\\')) {
+			if (w.at == w.buf + sizeof(w.buf))
+				profile_flush(w);
+			*w.at++ = '\\';
+		}
+		if (w.at == w.buf + sizeof(w.buf))
+			profile_flush(w);
+		*w.at++ = *s;
+	}
+}
+
+internal void
+profile_write_number(profile_writer& w, u64 x, i32 minwidth = 1)
+{
+	char digits[24];
+	i32 n = 0;
+	do
+		digits[n++] = (char)('0' + x % 10);
+	while ((x /= 10) != 0);
+	while (n < minwidth)
+		digits[n++] = '0';
+
+	char s[24];
+	i32 i = 0;
+	while (n)
+		s[i++] = digits[--n];
+	s[i] = 0;
+
+	profile_write(w, s);
+}
+
+// writes the events still held by the rings as a chrome trace, which
+// chrome://tracing and perfetto open. returns false if the file could not
+// be written.
+internal bool
+profile_export(profiler *p, const char *path)
+{
+	profile_writer *w = allocate<profile_writer>(1);
+	w->path = path;
+	w->at = w->buf;
+	w->ok = true;
+
+	u32 writes[MAX_WORKER_THREADS + 1];
+	u64 base = ~0ull;
+	for (i32 t = 0; t <= MAX_WORKER_THREADS; ++t) {
+		profile_ring& r = p->rings[t];
+		writes[t] = atomic_load(&r.write);
+		u32 first = profile_first_event(r, writes[t]);
+		if (first != writes[t])
+			base = min(base, r.events[first & (PROFILE_RING_SIZE - 1)].ticks);
+	}
+
+	profile_write(*w, "{\"traceEvents\":[\n");
+
+	bool first_event = true;
+	for (i32 t = 0; t <= MAX_WORKER_THREADS; ++t) {
+		profile_ring& r = p->rings[t];
+
+		// zones that began before the oldest event have lost their
+		// beginning. their ends are skipped.
+		i32 depth = 0;
+		for (u32 i = profile_first_event(r, writes[t]); i != writes[t]; ++i) {
+			const profile_event& e = r.events[i & (PROFILE_RING_SIZE - 1)];
+			if (!e.name && depth == 0)
+				continue;
+			depth += e.name ? 1 : -1;
+
+			u64 ticks = e.ticks - base;
+			u64 ns = ticks / p->frequency * 1000000000ull + ticks % p->frequency * 1000000000ull / p->frequency;
+
+			profile_write(*w, first_event ? "{\"name\":\"" : ",\n{\"name\":\"");
+			profile_write(*w, e.name ? e.name : "", true);
+			profile_write(*w, e.name ? "\",\"ph\":\"B\",\"ts\":" : "\",\"ph\":\"E\",\"ts\":");
+			profile_write_number(*w, ns / 1000);
+			profile_write(*w, ".");
+			profile_write_number(*w, ns % 1000, 3);
+			profile_write(*w, ",\"pid\":1,\"tid\":");
+			profile_write_number(*w, (u64)t);
+			profile_write(*w, "}");
+			first_event = false;
+		}
+	}
+
+	profile_write(*w, "\n]}\n");
+	profile_flush(*w);
+
+	bool result = w->ok;
+	sys_deallocate(w, sizeof(profile_writer), alignof(profile_writer));
+	return result;
+}
+
+#else
+
+#define profile_zone(name)
+#define profile_function()
+
+#endif
+
+////////
+//
+// frame pacing. between frames the platform sleeps until input arrives or
+// a timer runs out, instead of rendering as fast as vsync lets it. the code
+// module picks the mode and asks for frames through the frame_pacing that
+// sys_frame_pacing returns, and the platform measures how long input takes
+// to reach the screen.
+
+// renders after input, and when the code module asks for a frame.
+#define PACING_ON_DEMAND	0
+// renders target_fps frames a second.
+#define PACING_FIXED		1
+// renders every frame the display takes.
+#define PACING_VSYNC		2
+
+// latency samples kept. must be a power of two.
+#define PACING_SAMPLES		64
+
+struct frame_pacing
+{
+	i32 mode;
+	i32 target_fps;
+
+	// sys_ticks time at which the code module wants to render again when
+	// frames are rendered on demand. the platform sets it to ~0 before
+	// every frame, which waits for input.
+	u64 next_frame;
+
+	// ticks from the first input event a frame handled to the return of
+	// the buffer swap that presented it, for the last PACING_SAMPLES frames
+	// that handled input.
+	u64 latency[PACING_SAMPLES];
+	u64 latency_count;
+
+	u64 frames;
+	u64 wakeups;
+};
+
+// sys_ticks time of the frame after one due at last, or 0 for right away.
+// dirty means there was input or the window changed since then.
+inline u64
+next_frame_due(const frame_pacing& p, u64 last, u64 frequency, bool dirty)
+{
+	if (p.mode == PACING_FIXED)
+		return last + frequency / (u64)max(p.target_fps, 1);
+	if (p.mode == PACING_ON_DEMAND && !dirty)
+		return p.next_frame;
+	return 0;
+}
+
+// the time the frames after one that was due at due and started at now
+// are paced from. a fixed rate that fell a whole frame behind starts over.
+inline u64
+frame_start_time(const frame_pacing& p, u64 due, u64 now, u64 frequency)
+{
+	if (p.mode == PACING_FIXED && now - due < frequency / (u64)max(p.target_fps, 1))
+		return due;
+	return now;
+}
+
+// the platform calls this after presenting a frame. input is the sys_ticks
+// time of the first input event the frame handled, 0 if there was none.
+inline void
+frame_presented(frame_pacing& p, u64 input, u64 now)
+{
+	++p.frames;
+	if (input)
+		p.latency[p.latency_count++ & (PACING_SAMPLES - 1)] = now - input;
+}
+
+////////
+//
+// hot reloading. a thread of the platform waits for notifications that
+// the build replaced the code module, then copies and loads it and checks
+// that it exports every function. the main loop swaps it in between two
+// frames. the platform keeps these numbers for sys_code_reload.
+
+struct code_reload
+{
+	u64 count;
+
+	// ticks from the build writing the module to the end of the first
+	// frame rendered with it, for the last reload.
+	u64 latency;
+
+	// ticks spent copying and loading the last module on the watching
+	// thread, and swapping it in on the main loop.
+	u64 stage_ticks;
+	u64 swap_ticks;
+
+	// modules that did not load or missed a function.
+	u64 rejected;
+};
 
 #define GL_TRIANGLES            0x0004
+#define GL_TRIANGLE_STRIP       0x0005
 #define GL_COLOR_BUFFER_BIT	0x00004000
+#define GL_SHORT                0x1402
+#define GL_UNSIGNED_SHORT       0x1403
 #define GL_FLOAT                0x1406
 #define GL_ARRAY_BUFFER		0x8892
 #define GL_FRAGMENT_SHADER      0x8B30
@@ -143,16 +1181,40 @@ typedef float f32;
 #define GL_TEXTURE_WRAP_T       0x2803
 #define GL_CLAMP_TO_EDGE        0x812F
 #define GL_NEAREST              0x2600
+#define GL_LINEAR               0x2601
 #define GL_SRGB8_ALPHA8         0x8C43
 #define GL_RGBA                 0x1908
+#define GL_RED                  0x1903
+#define GL_R8                   0x8229
+#define GL_UNPACK_ROW_LENGTH    0x0CF2
+#define GL_UNPACK_ALIGNMENT     0x0CF5
+#define GL_PIXEL_UNPACK_BUFFER  0x88EC
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
 #define GL_UNSIGNED_BYTE        0x1401
 #define GL_BLEND                0x0BE2
 #define GL_ONE_MINUS_SRC_ALPHA  0x0303
 #define GL_ONE                  1
+#define GL_MAP_WRITE_BIT        0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_EXPIRED      0x911B
+#define GL_TIMESTAMP            0x8E28
+#define GL_QUERY_RESULT         0x8866
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
 
 #define BUTTON_LEFT	0x01
 #define BUTTON_RIGHT 	0x02
 
+// the glyph has to be rasterized before it can be drawn.
+#define GLYPH_UNLOADED	-1
+// the glyph is being rasterized on a worker thread.
+#define GLYPH_PENDING	-2
+// the glyph did not fit into the atlas. it is drawn as blank space and not
+// rasterized again.
+#define GLYPH_TOO_LARGE	-3
+
 struct glyph
 {
 	u32 codepoint;
@@ -162,13 +1224,31 @@ struct glyph
 
 	i32 xadv;
 
+	// atlas page and rectangle in texels, or one of the GLYPH_* states
+	// when the glyph is not resident.
+	i32 page;
 	i32 x0, y0, x1, y1;
+
+	// frame the glyph was last drawn in.
+	u32 last_used;
+
+	// the glyph in the font file, which kerning looks up. 0 when the
+	// platform renders the font.
+	u32 id;
 };
 
 struct font
 {
 	void *sys;
 
+	// the font file when the code module rasterizes the outlines itself, 0
+	// when the platform renders the font.
+	struct ttf_font *ttf;
+
+	// what the font was created from, so other threads can create their
+	// own instance to rasterize with.
+	const wchar_t *name;
+
 	i32 default_x;
 	i32 default_y;
 
@@ -181,32 +1261,55 @@ struct font
 	i32 height;
 	i32 external_leading;
 
+	i32 pixel_height;
+	i32 average_width;
+
+	// glyphs of a font with a nonzero sdf_spread are signed distance fields
+	// reaching sdf_spread texels to either side of the outline, which can
+	// be drawn at any scale. the code module sets it after creating the
+	// font, and the platform renders such fonts unhinted where it can.
+	i32 sdf_spread;
+	u32 pad;
+
+	// glyph cache. codepoints below 256 index latin1 directly, storing the
+	// glyph index + 1 so that a zeroed font starts out empty. everything
+	// else goes through glyph_map.
+	i32 latin1[256];
+	index_map<i32> glyph_map;
+
 	array<i32, glyph> glyphs;
 };
 
-#define SYSTEM_FUNCTIONS	\
-	X(void *, sys_allocate, size_t n, size_t alignment)	\
-	X(void, sys_deallocate, void *p, size_t n, size_t alignment)	\
-	X(struct font *, sys_create_font, const wchar_t *name, i32 pixel_height)	\
-	X(i32, sys_render_glyph, struct font *font, u32 codepoint)	\
-	/* end */
-
+// before unloading code the platform calls its migrate with the
+// state_layout of the code replacing it. migrate returns what the reload of
+// the new code gets.
 #define CODE_FUNCTIONS	\
 	X(void *, reload, void *userdata)	\
+	X(u64, state_layout, void)	\
+	X(void *, migrate, void *userdata, u64 layout)	\
 	X(void, render, void *userdata, i32 window_width, i32 window_height)	\
 	X(void, mouse, void *userdata, i32 x, i32 y, i32 dz, u32 buttons)	\
 	X(void, keyboard, void *userdata, u32 codepoint)	\
+	X(void, open_file, void *userdata, const char *path)	\
 	/* end */
 
 #define OPENGL_FUNCTIONS	\
 	X(void, glEnable, u32 cap)	\
 	X(void, glDisable, u32 cap)	\
 	X(void, glGenVertexArrays, i32 n, u32 *arrays)	\
+	X(void, glDeleteVertexArrays, i32 n, const u32 *arrays)	\
 	X(void, glBindVertexArray, u32 array)	\
 	X(void, glGenBuffers, i32 n, u32 *buffers)	\
+	X(void, glDeleteBuffers, i32 n, const u32 *buffers)	\
 	X(void, glBindBuffer, u32 target, u32 buffer)	\
 	X(void, glBufferData, u32 target, ptrdiff_t size, const void *data, u32 usage)	\
+	X(void *, glMapBufferRange, u32 target, ptrdiff_t offset, ptrdiff_t length, u32 access)	\
+	X(u8, glUnmapBuffer, u32 target)	\
+	X(void *, glFenceSync, u32 condition, u32 flags)	\
+	X(u32, glClientWaitSync, void *sync, u32 flags, u64 timeout)	\
+	X(void, glDeleteSync, void *sync)	\
 	X(u32, glCreateProgram, void)	\
+	X(void, glDeleteProgram, u32 program)	\
 	X(u32, glCreateShader, u32 shaderType)	\
 	X(void, glAttachShader, u32 program, u32 shader)	\
 	X(void, glDeleteShader, u32 shader)	\
@@ -219,16 +1322,26 @@ struct font
 	X(void, glViewport, i32 x, i32 y, i32 width, i32 height)	\
 	X(void, glVertexAttribPointer, u32 index, i32 size, u32 type, u8 normalized, i32 stride, const void *pointer)	\
 	X(void, glEnableVertexAttribArray, u32 index)	\
+	X(void, glVertexAttribDivisor, u32 index, u32 divisor)	\
 	X(void, glLinkProgram, u32 program)	\
 	X(void, glDrawArrays, u32 mode, i32 first, i32 count)	\
+	X(void, glDrawArraysInstanced, u32 mode, i32 first, i32 count, i32 instancecount)	\
 	X(void, glUseProgram, u32 program)	\
 	X(i32, glGetUniformLocation, u32 program, const char *name)	\
 	X(void, glUniformMatrix4fv, i32 location, i32 count, u8 transpose, const f32 *value)	\
 	X(void, glGenTextures, i32 n, u32 *textures)	\
+	X(void, glDeleteTextures, i32 n, const u32 *textures)	\
 	X(void, glTexParameteri, u32 target, u32 pname, i32 param)	\
 	X(void, glBindTexture, u32 target, u32 texture)	\
 	X(void, glTexImage2D, u32 target, i32 level, i32 internalFormat, i32 width, i32 height, i32 border, u32 format, u32 type, const void *data)	\
+	X(void, glTexSubImage2D, u32 target, i32 level, i32 xoffset, i32 yoffset, i32 width, i32 height, u32 format, u32 type, const void *data)	\
+	X(void, glPixelStorei, u32 pname, i32 param)	\
 	X(void, glBlendFunc, u32 sfactor, u32 dfactor)	\
 	X(void, glGetProgramInfoLog, u32 program, i32 maxLength, i32 *length, char *infoLog)	\
 	X(void, glGetShaderInfoLog, u32 shader, i32 maxLength, i32 *length, char *infoLog)	\
+	X(void, glGenQueries, i32 n, u32 *ids)	\
+	X(void, glDeleteQueries, i32 n, const u32 *ids)	\
+	X(void, glQueryCounter, u32 id, u32 target)	\
+	X(void, glGetQueryObjectiv, u32 id, u32 pname, i32 *params)	\
+	X(void, glGetQueryObjectui64v, u32 id, u32 pname, u64 *params)	\
 	/* end */
@@ -0,0 +1,487 @@
+// behavior tests for the code module. main returns the number of failed
+// checks.
+
+#include "harness.h"
+
+#include <initializer_list>
+
+static i32 global_failures;
+
+#define check(x)	\
+	do { if (!(x)) { ++global_failures; fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); } } while (0)
+
+////////
+//
+// index_map
+
+internal void
+test_index_map(void)
+{
+	index_map<i32> m = {};
+
+	check(find(m, 1) == 0);
+	check(!remove(m, 1));
+
+	// the empty slot marker can't be stored.
+	check(!insert(m, index_map<i32>::empty_key, 7));
+	check(find(m, index_map<i32>::empty_key) == 0);
+	check(!remove(m, index_map<i32>::empty_key));
+	check(m.count == 0);
+
+	// random inserts and removes against a direct table of the small key
+	// range, so that removes hit long probe runs and the backward shift
+	// has to move keys across the wrap at the end of the slots.
+	const u32 key_count = 4096;
+	i32 *reference = allocate<i32>(key_count);
+	fill_n(key_count, reference, -1);
+
+	u32 seed = 12345;
+	i32 count = 0;
+	for (i32 step = 0; step < 200000; ++step) {
+		seed = seed * 1664525 + 1013904223;
+		u32 key = (seed >> 8) % key_count;
+		// keys that share their low bits collide in a small table.
+		u32 stored = key << 20 | key;
+
+		if ((seed >> 4) % 3) {
+			if (reference[key] < 0)
+				++count;
+			reference[key] = step;
+			check(insert(m, stored, step));
+		} else {
+			bool present = reference[key] >= 0;
+			if (present)
+				--count;
+			reference[key] = -1;
+			check(remove(m, stored) == present);
+		}
+
+		if (step % 1000 == 0) {
+			for (u32 k = 0; k < key_count; ++k) {
+				i32 *v = find(m, k << 20 | k);
+				check(reference[k] < 0 ? v == 0 : v && *v == reference[k]);
+			}
+		}
+	}
+
+	check(m.count == count);
+	for (u32 k = 0; k < key_count; ++k) {
+		i32 *v = find(m, k << 20 | k);
+		check(reference[k] < 0 ? v == 0 : v && *v == reference[k]);
+	}
+
+	release(m);
+	check(m.limit == 0 && m.count == 0 && find(m, 1) == 0);
+
+	sys_deallocate(reference, key_count * sizeof(i32), alignof(i32));
+}
+
+////////
+//
+// utf-8
+
+// decodes s and checks it against the codepoints in expected.
+internal bool
+decodes_to(const char *s, std::initializer_list<u32> expected, i64 errors)
+{
+	size_t n = strlen(s);
+	utf8_reader r = { (const u8 *)s, (const u8 *)s + n, 0 };
+
+	for (u32 c : expected)
+		if (r.at == r.end || next_codepoint(r) != c)
+			return false;
+
+	return r.at == r.end && r.errors == errors;
+}
+
+internal void
+test_utf8(void)
+{
+	const u32 R = UTF8_REPLACEMENT;
+
+	check(decodes_to("a\x7F", { 'a', 0x7F }, 0));
+	check(decodes_to("\xC2\x80\xDF\xBF", { 0x80, 0x7FF }, 0));
+	check(decodes_to("\xE0\xA0\x80\xED\x9F\xBF\xEE\x80\x80\xEF\xBF\xBF", { 0x800, 0xD7FF, 0xE000, 0xFFFF }, 0));
+	check(decodes_to("\xF0\x90\x80\x80\xF4\x8F\xBF\xBF", { 0x10000, 0x10FFFF }, 0));
+
+	// overlong forms, surrogates, past U+10FFFF and bytes that never
+	// appear. the first byte is a maximal subpart of its own, the rest
+	// are stray continuation bytes.
+	check(decodes_to("\xC0\x80", { R, R }, 2));
+	check(decodes_to("\xE0\x80\x80", { R, R, R }, 3));
+	check(decodes_to("\xED\xA0\x80", { R, R, R }, 3));
+	check(decodes_to("\xF4\x90\x80\x80", { R, R, R, R }, 4));
+	check(decodes_to("\xFF" "a\xFE", { R, 'a', R }, 2));
+
+	// a truncated sequence is one maximal subpart.
+	check(decodes_to("\xE2\x82", { R }, 1));
+	check(decodes_to("\xF0\x9F\x98", { R }, 1));
+	check(decodes_to("\xE2\x82" "a", { R, 'a' }, 1));
+
+	// the example of the unicode standard, table 3-8.
+	check(decodes_to("a\xF1\x80\x80\xE1\x80\xC2" "b\x80" "c\x80\xBF" "d", { 'a', R, R, R, 'b', R, 'c', R, R, 'd' }, 6));
+
+	check(validate_utf8((const u8 *)"abc\xE2\x82\xAC", 6) == 6);
+	check(validate_utf8((const u8 *)"abc\xE2\x82", 5) == 3);
+
+	// the ascii scan stops at the first high byte wherever it falls in
+	// the vector loops.
+	u8 text[100];
+	for (size_t n = 0; n <= sizeof(text); ++n) {
+		fill_n(n, text, (u8)'x');
+		check(ascii_prefix(text, n) == n);
+		for (size_t i = 0; i < n; ++i) {
+			text[i] = 0x80;
+			check(ascii_prefix(text, n) == i);
+			text[i] = 'x';
+		}
+	}
+}
+
+////////
+//
+// skyline packer
+
+struct packed_rect { i32 page, x, y, w, h; };
+
+internal bool
+overlaps(const packed_rect& a, const packed_rect& b)
+{
+	return a.page == b.page &&
+		a.x < b.x + b.w && b.x < a.x + a.w &&
+		a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+internal void
+test_skyline(void)
+{
+	glyph_atlas atlas = {};
+	atlas.min_size = 128;
+	atlas.max_size = 256;
+	atlas.max_pages = 2;
+	add_page(atlas);
+
+	const i32 limit = 4096;
+	packed_rect *rects = allocate<packed_rect>(limit);
+	i32 count = 0;
+	i64 area = 0;
+
+	// glyph sized rectangles until the page is full, then again after it
+	// grew and once more on a second page.
+	u32 seed = 1;
+	for (i32 round = 0; round < 3; ++round) {
+		if (round == 1)
+			grow_page(atlas, atlas.pages[0]);
+		if (round == 2)
+			add_page(atlas);
+
+		for (i32 failures = 0; failures < 8 && count < limit;) {
+			seed = seed * 1664525 + 1013904223;
+			packed_rect r = {};
+			r.w = 1 + (i32)(seed >> 8) % 12;
+			r.h = 4 + (i32)(seed >> 16) % 14;
+			if (!pack_rect(atlas, r.w, r.h, &r.page, &r.x, &r.y)) {
+				++failures;
+				continue;
+			}
+			rects[count++] = r;
+			area += (i64)r.w * r.h;
+		}
+	}
+
+	i64 used = 0;
+	i64 capacity = 0;
+	for (i32 i = 0; i < atlas.page_count; ++i) {
+		used += atlas.pages[i].used;
+		capacity += (i64)atlas.pages[i].size * atlas.pages[i].size;
+	}
+	check(atlas.page_count == 2);
+	check(used == area);
+	// a skyline wastes little on rectangles of similar height.
+	check(area > capacity * 3 / 4);
+
+	i32 outside = 0;
+	i32 overlapping = 0;
+	for (i32 i = 0; i < count; ++i) {
+		const packed_rect& a = rects[i];
+		i32 size = atlas.pages[a.page].size;
+		if (a.x < 0 || a.y < 0 || a.x + a.w > size || a.y + a.h > size)
+			++outside;
+		for (i32 j = i + 1; j < count; ++j)
+			if (overlaps(a, rects[j]))
+				++overlapping;
+	}
+	check(outside == 0);
+	check(overlapping == 0);
+
+	sys_deallocate(rects, limit * sizeof(packed_rect), alignof(packed_rect));
+}
+
+// a glyph that does not fit is not rasterized and repacked for again.
+internal void
+test_too_large(app_state *state)
+{
+	struct font *font = state->sdf_font;
+	glyph_atlas& atlas = font_atlas(state, font);
+	i32 repacks = atlas.repacks;
+
+	// bigger than any page.
+	glyph *g = add_glyph(font, 0x10000);
+	i32 stride;
+	check(!allocate_glyph(state, font, g, { 0, 0, atlas.max_size, 9 }, &stride));
+	check(g->page == GLYPH_TOO_LARGE);
+	check(atlas.repacks == repacks);
+
+	// fits a page, but not next to what the current frame draws.
+	++state->frame;
+	i32 n = atlas.max_size * 3 / 4;
+	for (i32 i = 0; i < atlas.max_pages; ++i) {
+		g = add_glyph(font, 0x10001 + (u32)i);
+		g->last_used = state->frame;
+		check(allocate_glyph(state, font, g, { 0, 0, n - 1, n - 1 }, &stride) != 0);
+	}
+
+	g = add_glyph(font, 0x10100);
+	check(!allocate_glyph(state, font, g, { 0, 0, n - 1, n - 1 }, &stride));
+	check(g->page == GLYPH_TOO_LARGE);
+	check(atlas.too_large == 2);
+
+	// drawing it again doesn't try again.
+	repacks = atlas.repacks;
+	i64 rasterized = atlas.rasterized;
+	for (i32 i = 0; i < 3; ++i) {
+		++state->frame;
+		check(render_glyph(state, font, 0x10100)->page == GLYPH_TOO_LARGE);
+	}
+	check(atlas.repacks == repacks);
+	check(atlas.rasterized == rasterized);
+}
+
+// a frame that misses more glyphs than the work ring holds queues jobs up
+// to GLYPH_JOBS_MAX and rasterizes the rest right away.
+internal void
+test_glyph_jobs(app_state *state)
+{
+	struct font *font = state->console_font;
+	++state->frame;
+	for (u32 i = 0; i < 2000; ++i)
+		render_glyph(state, font, 0x4E00 + i);
+	check(state->workers.in_flight <= GLYPH_JOBS_MAX);
+
+	sys_complete_work();
+	receive_glyphs(state);
+	check(state->workers.in_flight == 0);
+	for (u32 i = 0; i < 2000; ++i) {
+		i32 page = find_glyph(font, 0x4E00 + i)->page;
+		check(page != GLYPH_UNLOADED && page != GLYPH_PENDING);
+	}
+}
+
+// panels are recorded by the render thread and the workers. the render
+// thread waits for the panels only, and queues at most a job per worker.
+internal void
+test_panels(app_state *state)
+{
+	keyboard(state, KEY_FILL_CONSOLE);
+	keyboard(state, KEY_TOGGLE_PANELS);
+
+	panel_job& job = state->panels.job;
+	for (i32 i = 0; i < 20; ++i) {
+		mouse(state, 100, 500, i % 2 ? -120 : 120, 0);
+		render(state, 1920, 1080);
+		check(job.count > 0 && job.done == (u32)job.count);
+		check(job.queued <= (u32)state->workers.count);
+	}
+
+	keyboard(state, KEY_TOGGLE_PANELS);
+	sys_complete_work();
+	check(job.queued == 0);
+}
+
+////////
+//
+// glyph cache file
+
+internal i64
+rasterized(app_state *state)
+{
+	return state->atlas.rasterized + state->sdf_atlas.rasterized;
+}
+
+// the first skyline node and the first packed glyph of a cache file.
+internal void
+find_cache_records(u8 *bytes, size_t size, skyline_node **node, glyph **packed)
+{
+	const u8 *at = bytes;
+	const u8 *end = bytes + size;
+	const glyph_cache_header *h = (const glyph_cache_header *)read_bytes(at, end, sizeof(glyph_cache_header));
+
+	*node = 0;
+	*packed = 0;
+	for (i32 a = 0; a < 2; ++a) {
+		for (i32 i = 0; i < h->page_counts[a]; ++i) {
+			const glyph_cache_page *p = (const glyph_cache_page *)read_bytes(at, end, sizeof(glyph_cache_page));
+			skyline_node *nodes = (skyline_node *)read_bytes(at, end, (size_t)p->skyline_count * sizeof(skyline_node));
+			read_bytes(at, end, (size_t)p->size * (size_t)p->size);
+			if (!*node)
+				*node = nodes;
+		}
+	}
+
+	for (i32 i = 0; i < h->font_count; ++i) {
+		const glyph_cache_font *key = (const glyph_cache_font *)read_bytes(at, end, sizeof(glyph_cache_font));
+		glyph *glyphs = (glyph *)read_bytes(at, end, (size_t)key->glyph_count * sizeof(glyph));
+		for (i32 j = 0; !*packed && j < key->glyph_count; ++j)
+			if (is_packed(glyphs[j]))
+				*packed = &glyphs[j];
+	}
+}
+
+internal void
+test_glyph_cache(void)
+{
+	remove(GLYPH_CACHE_FILE);
+
+	// a cold start rasterizes and writes the cache.
+	app_state *cold = (app_state *)reload(0);
+	check(cold->cached_fonts == 0);
+	check(rasterized(cold) > 0);
+
+	FILE *file = fopen(GLYPH_CACHE_FILE, "rb");
+	check(file != 0);
+	if (!file)
+		return;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	u8 *bytes = allocate<u8>((size_t)size);
+	check(fread(bytes, 1, (size_t)size, file) == (size_t)size);
+	fclose(file);
+
+	// the next start takes every font's glyphs from it.
+	app_state *warm = (app_state *)reload(0);
+	check(warm->cached_fonts == 3);
+	check(rasterized(warm) == 0);
+
+	glyph *a = find_glyph(cold->console_font, 'a');
+	glyph *b = find_glyph(warm->console_font, 'a');
+	check(a && b && is_packed(*b));
+	if (a && b)
+		check(a->page == b->page && a->x0 == b->x0 && a->y0 == b->y0 && a->x1 == b->x1 && a->y1 == b->y1 && a->xadv == b->xadv);
+
+	// a truncated file is ignored, and written again.
+	check(sys_write_file(GLYPH_CACHE_FILE, bytes, (size_t)size / 2, false));
+	app_state *truncated = (app_state *)reload(0);
+	check(truncated->cached_fonts == 0);
+	check(rasterized(truncated) == rasterized(cold));
+
+	app_state *rewritten = (app_state *)reload(0);
+	check(rewritten->cached_fonts == 3);
+
+	// so is one whose skyline or glyph rectangles reach out of their page.
+	skyline_node *node;
+	glyph *packed;
+	find_cache_records(bytes, (size_t)size, &node, &packed);
+	check(node && packed);
+	if (node && packed) {
+		i32 width = node->width;
+		node->width += 64;
+		check(sys_write_file(GLYPH_CACHE_FILE, bytes, (size_t)size, false));
+		check(((app_state *)reload(0))->cached_fonts == 0);
+		node->width = width;
+
+		packed->x1 += 1 << 16;
+		check(sys_write_file(GLYPH_CACHE_FILE, bytes, (size_t)size, false));
+		check(((app_state *)reload(0))->cached_fonts == 0);
+	}
+
+	sys_deallocate(bytes, (size_t)size, alignof(u8));
+}
+
+////////
+//
+// state migration
+
+// what a reload of code with another state layout gets back.
+internal app_state *
+change_layout(app_state *state)
+{
+	void *carried = migrate(state, STATE_LAYOUT + 1);
+	return (app_state *)reload(carried);
+}
+
+internal void
+test_migrate(app_state *state)
+{
+	// the same layout keeps the state as it is.
+	check(migrate(state, STATE_LAYOUT) == state);
+	check(reload(state) == state);
+
+	const char *line = "carried over\n";
+	append_console(state->console, line, string_length(line));
+	u64 lines = state->console.line_end;
+	struct font *console_font = state->console_font;
+	struct font *sdf_font = state->sdf_font;
+	i32 font_count = state->fonts.count;
+	i64 rasterized = state->atlas.rasterized;
+	i32 glyphs = console_font->glyphs.count;
+	state->sdf_scale = 2.f;
+
+	// another layout carries the fonts with their glyphs, the atlas and
+	// the console.
+	state = change_layout(state);
+	check(state->layout == STATE_LAYOUT);
+	check(state->fonts.count == font_count);
+	check(state->console_font == console_font);
+	check(state->sdf_font == sdf_font);
+	check(console_font->glyphs.count == glyphs);
+	check(state->atlas.rasterized == rasterized);
+	check(state->console.line_end == lines);
+	check(state->sdf_scale == 2.f);
+
+	// nothing is rasterized again.
+	render_glyph(state, console_font, 'a');
+	check(state->atlas.rasterized == rasterized);
+
+	// the old state and the carried one are freed, so the permanent arena
+	// stays the same size however often the layout changes.
+	size_t used = state->permanent_arena.used;
+	for (i32 i = 0; i < 8; ++i)
+		state = change_layout(state);
+	check(state->permanent_arena.used == used);
+	check(state->console_font == console_font);
+
+	// anything that isn't a carried_state of this layout starts over.
+	carried_state *c = (carried_state *)migrate(state, STATE_LAYOUT + 1);
+	c->layout = CARRIED_LAYOUT + 1;
+	state = (app_state *)reload(c);
+	check(state->layout == STATE_LAYOUT);
+	check(state->console_font != console_font);
+	check(state->fonts.count == font_count);
+}
+
+int
+main(void)
+{
+	start_harness(2);
+
+	remove(GLYPH_CACHE_FILE);
+
+	test_index_map();
+	test_utf8();
+	test_skyline();
+
+	use_fake_fonts();
+	app_state *state = (app_state *)reload(0);
+	test_too_large(state);
+	test_glyph_jobs(state);
+	test_panels(state);
+	test_migrate(state);
+	test_glyph_cache();
+
+	remove(GLYPH_CACHE_FILE);
+
+	if (global_failures)
+		fprintf(stderr, "%d checks failed\n", global_failures);
+	return global_failures != 0;
+}
@@ -0,0 +1,106 @@
+// shared by the tests and the benchmarks. both include code.cpp, so they
+// reach its internals, and link the linux platform from platform.cpp. gl
+// calls go to stubs that hand out names and a buffer to map, so no context
+// is needed.
+
+#include "../code.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// platform.cpp
+void start_platform(i32 worker_count);
+void bind_platform(void *(*symbol)(const char *name));
+
+internal void *
+code_symbol(const char *name)
+{
+	#define X(ret, name_, ...)	\
+		if (strcmp(name, #name_) == 0) return (void *)&name_;
+
+		SYSTEM_FUNCTIONS
+	#undef X
+
+	return 0;
+}
+
+////////
+//
+// gl stubs.
+
+#define STUB_BUFFER_SIZE	((size_t)16 << 20)
+
+static u32 global_stub_name = 1;
+alignas(64) static u8 global_stub_buffer[STUB_BUFFER_SIZE];
+
+template<typename T> internal T stub_result() { return T(); }
+
+#define X(ret, name, ...)	\
+	internal ret stub_##name(__VA_ARGS__) { return stub_result<ret>(); }
+
+	OPENGL_FUNCTIONS
+#undef X
+
+internal void stub_generate(i32 n, u32 *names) { for (i32 i = 0; i < n; ++i) names[i] = global_stub_name++; }
+internal u32 stub_create(void) { return global_stub_name++; }
+internal u32 stub_create_shader(u32) { return global_stub_name++; }
+internal void stub_compiled(u32, u32, i32 *params) { *params = 1; }
+internal void *stub_map(u32, ptrdiff_t, ptrdiff_t length, u32) { assert((size_t)length <= STUB_BUFFER_SIZE); return global_stub_buffer; }
+internal u8 stub_unmap(u32) { return 1; }
+
+////////
+//
+// fonts. with use_fake_fonts no font files are read: fonts get the metrics
+// the platform falls back to, and glyphs render as solid boxes of width
+// 2 + codepoint % 7, so tests don't depend on the fonts installed.
+
+internal bool fake_find_font_file(const wchar_t *, char *, size_t, i32 *) { return false; }
+
+internal i32
+fake_render_glyph(struct font *font, u32 codepoint)
+{
+	fill_n(font->bitmap_width * font->bitmap_height, font->bits, 0u);
+
+	i32 w = min(2 + (i32)(codepoint % 7), font->bitmap_width - font->default_x);
+	for (i32 y = font->default_y; y < font->default_y + font->ascent; ++y)
+		fill_n(w, font->bits + y * font->bitmap_width + font->default_x, 0xFFFFFFu);
+
+	return w + 1;
+}
+
+internal void
+use_fake_fonts(void)
+{
+	sys_find_font_file = fake_find_font_file;
+	sys_render_glyph = fake_render_glyph;
+}
+
+// starts the platform with the given number of worker threads and binds
+// everything code.cpp calls.
+internal void
+start_harness(i32 worker_count)
+{
+	start_platform(worker_count);
+	bind_platform(code_symbol);
+#if PROFILER
+	global_profiler = sys_profiler();
+#endif
+
+	#define X(ret, name, ...)	\
+		name = stub_##name;
+
+		OPENGL_FUNCTIONS
+	#undef X
+
+	glGenVertexArrays = stub_generate;
+	glGenBuffers = stub_generate;
+	glGenTextures = stub_generate;
+	glGenQueries = stub_generate;
+	glCreateProgram = stub_create;
+	glCreateShader = stub_create_shader;
+	glGetShaderiv = stub_compiled;
+	glGetProgramiv = stub_compiled;
+	glMapBufferRange = stub_map;
+	glUnmapBuffer = stub_unmap;
+}
@@ -0,0 +1,24 @@
+// the linux platform without its main loop, for the tests and the
+// benchmarks. they include code.cpp, which reaches the platform through
+// the pointers bind_platform fills in.
+
+#define main platform_main
+#include "../linux_main.cpp"
+#undef main
+
+void
+start_platform(i32 worker_count)
+{
+	start_profiler();
+	start_workers(worker_count);
+}
+
+void
+bind_platform(void *(*symbol)(const char *name))
+{
+	#define X(ret, name, ...)	\
+		*(ret (**)(__VA_ARGS__))symbol(#name) = name;
+
+		SYSTEM_FUNCTIONS
+	#undef X
+}